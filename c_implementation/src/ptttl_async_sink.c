@@ -0,0 +1,280 @@
+/* ptttl_async_sink.c
+ *
+ * Output sink (see ptttl_output_sink.h) that hands data off to a background writer
+ * thread, so that generating samples and writing them to slow storage can overlap.
+ * Data written to the sink is collected into one of several caller-provided buffers;
+ * each time a buffer fills up, it is queued for the writer thread, which writes it to
+ * the downstream sink while the caller goes on to fill the next buffer.
+ *
+ * Requires ptttl_output_sink.c
+ *
+ * Requires stdint.h, memcpy() from string.h, and POSIX threads (pthread.h)
+ *
+ * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
+ *
+ * Erik Nyquist 2025
+ */
+
+#include <string.h>
+
+#include "ptttl_async_sink.h"
+
+
+/**
+ * Writer thread; writes queued buffers to the downstream sink, in order, until
+ * asked to stop and no more buffers are queued
+ *
+ * @param arg  Pointer to async sink state object
+ *
+ * @return NULL
+ */
+static void *_writer_thread(void *arg)
+{
+    ptttl_async_sink_t *async = (ptttl_async_sink_t *) arg;
+
+    pthread_mutex_lock(&async->lock);
+
+    while (1)
+    {
+        while ((0u == async->queued) && (0u == async->stop))
+        {
+            pthread_cond_wait(&async->cond, &async->lock);
+        }
+
+        if (0u == async->queued)
+        {
+            // Asked to stop, and nothing left to write
+            break;
+        }
+
+        uint32_t index = async->write_index;
+        int error = async->error;
+        pthread_mutex_unlock(&async->lock);
+
+        // Write buffer without holding the lock, so the caller can keep filling the next one
+        int ret = 0;
+        if (0 == error)
+        {
+            ret = async->downstream->write(async->downstream->context,
+                                           &async->buffers[async->buffer_size * index],
+                                           async->buffer_lengths[index]);
+        }
+
+        pthread_mutex_lock(&async->lock);
+
+        if (0 != ret)
+        {
+            async->error = -1;
+        }
+
+        async->write_index = (index + 1u) % async->buffer_count;
+        async->queued -= 1u;
+        pthread_cond_broadcast(&async->cond);
+    }
+
+    pthread_mutex_unlock(&async->lock);
+
+    return NULL;
+}
+
+/**
+ * Queue the buffer currently being filled for the writer thread, and move on to
+ * the next buffer, waiting until it is no longer queued if necessary
+ *
+ * @param async  Pointer to async sink state object
+ *
+ * @return 0 if successful, -1 if the downstream sink has reported an error
+ */
+static int _queue_fill_buffer(ptttl_async_sink_t *async)
+{
+    pthread_mutex_lock(&async->lock);
+
+    async->queued += 1u;
+    pthread_cond_broadcast(&async->cond);
+
+    // If all buffers are queued, then the next buffer to fill is still waiting to be written
+    while (async->queued == async->buffer_count)
+    {
+        pthread_cond_wait(&async->cond, &async->lock);
+    }
+
+    int error = async->error;
+    pthread_mutex_unlock(&async->lock);
+
+    async->fill_index = (async->fill_index + 1u) % async->buffer_count;
+    async->buffer_lengths[async->fill_index] = 0u;
+
+    return error;
+}
+
+/**
+ * Queue the buffer currently being filled (if it has any data), and wait until the
+ * writer thread has written all queued buffers
+ *
+ * @param async  Pointer to async sink state object
+ *
+ * @return 0 if successful, -1 if the downstream sink has reported an error
+ */
+static int _drain(ptttl_async_sink_t *async)
+{
+    if (0u < async->buffer_lengths[async->fill_index])
+    {
+        (void) _queue_fill_buffer(async);
+    }
+
+    pthread_mutex_lock(&async->lock);
+
+    while (0u < async->queued)
+    {
+        pthread_cond_wait(&async->cond, &async->lock);
+    }
+
+    int error = async->error;
+    pthread_mutex_unlock(&async->lock);
+
+    return error;
+}
+
+// ptttl_output_sink_t write callback for async sinks
+static int _async_write(void *context, const void *data, size_t size)
+{
+    ptttl_async_sink_t *async = (ptttl_async_sink_t *) context;
+    const uint8_t *bytes = (const uint8_t *) data;
+
+    while (size > 0u)
+    {
+        size_t *length = &async->buffer_lengths[async->fill_index];
+        size_t copy_size = async->buffer_size - *length;
+        if (copy_size > size)
+        {
+            copy_size = size;
+        }
+
+        memcpy(&async->buffers[(async->buffer_size * async->fill_index) + *length], bytes, copy_size);
+        *length += copy_size;
+        bytes += copy_size;
+        size -= copy_size;
+
+        if (*length == async->buffer_size)
+        {
+            if (0 != _queue_fill_buffer(async))
+            {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// ptttl_output_sink_t seek callback for async sinks
+static int _async_seek(void *context, uint64_t position)
+{
+    ptttl_async_sink_t *async = (ptttl_async_sink_t *) context;
+
+    if (0 != _drain(async))
+    {
+        return -1;
+    }
+
+    return async->downstream->seek(async->downstream->context, position);
+}
+
+// ptttl_output_sink_t flush callback for async sinks
+static int _async_flush(void *context)
+{
+    ptttl_async_sink_t *async = (ptttl_async_sink_t *) context;
+
+    if (0 != _drain(async))
+    {
+        return -1;
+    }
+
+    if (NULL != async->downstream->flush)
+    {
+        return async->downstream->flush(async->downstream->context);
+    }
+
+    return 0;
+}
+
+/**
+ * @see ptttl_async_sink.h
+ */
+int ptttl_output_sink_init_async(ptttl_output_sink_t *sink, ptttl_async_sink_t *async,
+                                 ptttl_output_sink_t *downstream, void *buffers,
+                                 uint32_t buffer_count, size_t buffer_size)
+{
+    if ((NULL == sink) || (NULL == async) || (NULL == downstream) || (NULL == buffers))
+    {
+        return -1;
+    }
+
+    if ((NULL == downstream->write) || (2u > buffer_count) ||
+        (PTTTL_ASYNC_SINK_MAX_BUFFERS < buffer_count) || (0u == buffer_size))
+    {
+        return -1;
+    }
+
+    async->downstream = downstream;
+    async->buffers = (uint8_t *) buffers;
+    async->buffer_size = buffer_size;
+    async->buffer_count = buffer_count;
+    async->fill_index = 0u;
+    async->write_index = 0u;
+    async->queued = 0u;
+    async->stop = 0u;
+    async->error = 0;
+    async->buffer_lengths[0] = 0u;
+
+    if (0 != pthread_mutex_init(&async->lock, NULL))
+    {
+        return -1;
+    }
+
+    if (0 != pthread_cond_init(&async->cond, NULL))
+    {
+        pthread_mutex_destroy(&async->lock);
+        return -1;
+    }
+
+    if (0 != pthread_create(&async->thread, NULL, _writer_thread, async))
+    {
+        pthread_cond_destroy(&async->cond);
+        pthread_mutex_destroy(&async->lock);
+        return -1;
+    }
+
+    sink->write = _async_write;
+    sink->seek = (NULL == downstream->seek) ? NULL : _async_seek;
+    sink->flush = _async_flush;
+    sink->context = async;
+
+    return 0;
+}
+
+/**
+ * @see ptttl_async_sink.h
+ */
+int ptttl_async_sink_stop(ptttl_async_sink_t *async)
+{
+    if (NULL == async)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&async->lock);
+    async->stop = 1u;
+    pthread_cond_broadcast(&async->cond);
+    pthread_mutex_unlock(&async->lock);
+
+    if (0 != pthread_join(async->thread, NULL))
+    {
+        return -1;
+    }
+
+    pthread_cond_destroy(&async->cond);
+    pthread_mutex_destroy(&async->lock);
+
+    return async->error;
+}
@@ -0,0 +1,104 @@
+/* ptttl_async_sink.h
+ *
+ * Output sink (see ptttl_output_sink.h) that hands data off to a background writer
+ * thread, so that generating samples and writing them to slow storage can overlap.
+ * Data written to the sink is collected into one of several caller-provided buffers;
+ * each time a buffer fills up, it is queued for the writer thread, which writes it to
+ * the downstream sink while the caller goes on to fill the next buffer.
+ *
+ * Requires ptttl_output_sink.c
+ *
+ * Requires stdint.h, memcpy() from string.h, and POSIX threads (pthread.h)
+ *
+ * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
+ *
+ * Erik Nyquist 2025
+ */
+
+#ifndef PTTTL_ASYNC_SINK_H
+#define PTTTL_ASYNC_SINK_H
+
+
+#include <stdint.h>
+#include <pthread.h>
+#include "ptttl_output_sink.h"
+
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+
+/**
+ * Maximum number of buffers that can be used by a single async sink. This setting
+ * affects the size of the ptttl_async_sink_t struct.
+ */
+#ifndef PTTTL_ASYNC_SINK_MAX_BUFFERS
+#define PTTTL_ASYNC_SINK_MAX_BUFFERS (8u)
+#endif // PTTTL_ASYNC_SINK_MAX_BUFFERS
+
+
+/**
+ * Holds the state of an async sink and its writer thread
+ */
+typedef struct
+{
+    ptttl_output_sink_t *downstream;    ///< Sink that the writer thread writes to
+    uint8_t *buffers;                   ///< Caller-provided storage for all buffers, back-to-back
+    size_t buffer_size;                 ///< Size of each buffer in bytes
+    uint32_t buffer_count;              ///< Number of buffers
+    uint32_t fill_index;                ///< Index of buffer currently being filled, owned by the caller
+    size_t buffer_lengths[PTTTL_ASYNC_SINK_MAX_BUFFERS]; ///< No. of bytes of data in each buffer
+    uint32_t write_index;               ///< Index of next buffer to be written by the writer thread
+    uint32_t queued;                    ///< No. of buffers queued for the writer thread
+    uint8_t stop;                       ///< 1 if writer thread has been asked to exit
+    int error;                          ///< -1 if the downstream sink has reported an error
+    pthread_mutex_t lock;               ///< Protects all fields shared with the writer thread
+    pthread_cond_t cond;                ///< Signalled whenever 'queued' or 'stop' changes
+    pthread_t thread;                   ///< Writer thread
+} ptttl_async_sink_t;
+
+
+/**
+ * Initialize an async sink, and start its writer thread. #ptttl_async_sink_stop must be
+ * called once the sink is no longer needed, to stop the writer thread.
+ *
+ * Only one thread may write to the async sink at a time. Writes to the async sink only
+ * block if all buffers are queued for the writer thread; more buffers hide more I/O
+ * latency, and larger buffers mean fewer (larger) writes to the downstream sink.
+ *
+ * Errors reported by the downstream sink are returned by the next write to, or flush
+ * of, the async sink.
+ *
+ * @param sink           Pointer to sink object to initialize
+ * @param async          Pointer to async sink state object, must remain valid as long
+ *                       as the sink is in use
+ * @param downstream     Pointer to sink that the writer thread should write to
+ * @param buffers        Pointer to storage for (buffer_count * buffer_size) bytes
+ * @param buffer_count   Number of buffers. Must be at least 2, and no more than
+ *                       #PTTTL_ASYNC_SINK_MAX_BUFFERS.
+ * @param buffer_size    Size of each buffer in bytes
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+int ptttl_output_sink_init_async(ptttl_output_sink_t *sink, ptttl_async_sink_t *async,
+                                 ptttl_output_sink_t *downstream, void *buffers,
+                                 uint32_t buffer_count, size_t buffer_size);
+
+/**
+ * Stop the writer thread of an async sink, after it has written all queued buffers.
+ * Data in a partially filled buffer is discarded, unless the sink has been flushed.
+ *
+ * @param async   Pointer to async sink state object
+ *
+ * @return 0 if successful, -1 if an error occurred, or if the downstream sink has
+ *         reported an error
+ */
+int ptttl_async_sink_stop(ptttl_async_sink_t *async);
+
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // PTTTL_ASYNC_SINK_H
@@ -3,7 +3,7 @@
  * Sample main.c which implements a command-line tool for converting PTTTL/RTTTL
  * source into .wav file, illustrating how to use ptttl_parser.c and ptttl_to_wav.c.
  *
- * Requires ptttl_parser.c, ptttl_sample_generator.c, and ptttl_to_wav.c
+ * Requires ptttl_parser.c, ptttl_sample_generator.c, ptttl_output_sink.c and ptttl_to_wav.c
  *
  * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
  *
@@ -12,13 +12,18 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include "ptttl_parser.h"
 #include "ptttl_to_wav.h"
+#include "ptttl_to_flac.h"
 
 // File pointer for RTTTL/PTTTL source file
 static FILE *fp = NULL;
 
+// FLAC encoder state, too large for the stack
+static ptttl_flac_encoder_t flac_encoder;
+
 // ptttl_input_iface_t callback to read the next PTTTL/RTTTL source character from the open file
 static int _read(char *nextchar)
 {
@@ -46,6 +51,8 @@ int main(int argc, char *argv[])
     if (3 != argc)
     {
         printf("Usage: %s <PTTTL/RTTTL filename> <output filename>\n", argv[0]);
+        printf("\nIf <output filename> is '-', then .wav data is written to stdout.\n");
+        printf("If <output filename> ends with '.flac', then a FLAC file is written.\n");
         return -1;
     }
 
@@ -64,17 +71,37 @@ int main(int argc, char *argv[])
     if (0 > ret)
     {
         ptttl_parser_error_t err = ptttl_parser_error(&parser);
-        printf("Error in %s (line %d, column %d): %s\n", argv[1], err.line, err.column, err.error_message);
+        fprintf(stderr, "Error in %s (line %d, column %d): %s\n", argv[1], err.line, err.column, err.error_message);
     }
 
-    if (0 == ret)
+    size_t filename_len = strlen(argv[2]);
+    if ((0 == ret) && (filename_len > 5u) && (0 == strcmp(&argv[2][filename_len - 5u], ".flac")))
+    {
+        // Parse PTTTL/RTTTL source and convert to FLAC file
+        ret = ptttl_to_flac(&parser, argv[2], &flac_encoder);
+        if (ret < 0)
+        {
+            ptttl_parser_error_t err = ptttl_to_flac_error();
+            fprintf(stderr, "Error Generating FLAC file (%s, line %d, column %d): %s\n", argv[1], err.line,
+                   err.column, err.error_message);
+        }
+    }
+    else if (0 == ret)
     {
         // Parse PTTTL/RTTTL source and convert to .wav file
-        ret = ptttl_to_wav(&parser, argv[2]);
+        if (0 == strcmp(argv[2], "-"))
+        {
+            ret = ptttl_to_wav_stream(&parser, stdout);
+        }
+        else
+        {
+            ret = ptttl_to_wav(&parser, argv[2]);
+        }
+
         if (ret < 0)
         {
             ptttl_parser_error_t err = ptttl_to_wav_error();
-            printf("Error Generating WAV file (%s, line %d, column %d): %s\n", argv[1], err.line,
+            fprintf(stderr, "Error Generating WAV file (%s, line %d, column %d): %s\n", argv[1], err.line,
                    err.column, err.error_message);
         }
     }
@@ -24,6 +24,10 @@
 // Number of valid note duration values
 #define NOTE_DURATION_COUNT (6u)
 
+// Offset basis and prime for 64-bit FNV-1a hashing, used for block and note fingerprints
+#define FNV1A_64_OFFSET (0xcbf29ce484222325ull)
+#define FNV1A_64_PRIME  (0x100000001b3ull)
+
 
 /**
  * Enumerates all possible musical notes in a single octave
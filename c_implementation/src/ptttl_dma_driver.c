@@ -0,0 +1,192 @@
+/* ptttl_dma_driver.c
+ *
+ * Double-buffer ("ping-pong") driver for feeding the output of ptttl_sample_generator.c
+ * to a DAC or I2S peripheral via DMA. The DMA controller continuously plays a single
+ * buffer that is split into two halves (A and B); while the DMA is playing one half,
+ * the other half is refilled from the half-complete and full-complete interrupts.
+ *
+ * Requires ptttl_parser.c and ptttl_sample_generator.c
+ *
+ * Requires stdint.h and memset() from string.h
+ *
+ * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
+ *
+ * Erik Nyquist 2025
+ */
+
+#include <string.h>
+
+#include "ptttl_dma_driver.h"
+
+
+/**
+ * Fill one half of the DMA buffer with exactly 'half_samples' samples, padding with
+ * silence once the generator has no more samples, or if a prefetch buffer runs dry
+ *
+ * @param driver  Pointer to initialized driver instance
+ * @param half    Buffer half to fill
+ *
+ * @return 0 if successful, 1 if all samples have been generated, -1 if an error occurred
+ */
+static int _fill_half(ptttl_dma_driver_t *driver, ptttl_dma_half_e half)
+{
+    uint32_t start_cycles = 0u;
+    if (NULL != driver->read_cycle_counter)
+    {
+        start_cycles = driver->read_cycle_counter();
+    }
+
+    ptttl_sample_format_e format = driver->generator->config.sample_format;
+    size_t frame_size = (size_t) ptttl_sample_format_size(format) * driver->generator->config.output_channels;
+    uint8_t *samples = &driver->buffer[driver->half_samples * frame_size * (size_t) half];
+    uint32_t num_samples = 0u;
+    int ret = 1;
+
+    if (0u == driver->finished)
+    {
+        num_samples = driver->half_samples;
+        ret = ptttl_sample_generator_generate_no_parse(driver->generator, &num_samples, samples);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        else if (2 == ret)
+        {
+            // Prefetch buffer ran dry; pad with silence until the next service call refills it
+            driver->underrun_count += 1u;
+            ret = 0;
+        }
+
+        driver->finished = (uint8_t) ret;
+    }
+
+    if (num_samples < driver->half_samples)
+    {
+        // Silence is 0 in all sample formats, except for unsigned 8-bit samples
+        int silence = (PTTTL_SAMPLE_FORMAT_U8 == format) ? 0x80 : 0;
+        memset(&samples[num_samples * frame_size], silence,
+               (driver->half_samples - num_samples) * frame_size);
+    }
+
+    if (NULL != driver->read_cycle_counter)
+    {
+        // Unsigned subtraction handles the counter wrapping around
+        uint32_t cycles = driver->read_cycle_counter() - start_cycles;
+        if (cycles > driver->worst_case_cycles[half])
+        {
+            driver->worst_case_cycles[half] = cycles;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @see ptttl_dma_driver.h
+ */
+int ptttl_dma_driver_init(ptttl_dma_driver_t *driver, ptttl_sample_generator_t *generator,
+                          void *buffer, uint32_t half_samples,
+                          uint32_t (*read_cycle_counter)(void))
+{
+    if ((NULL == driver) || (NULL == generator) || (NULL == buffer) || (0u == half_samples))
+    {
+        return -1;
+    }
+
+    if (0u != (((uintptr_t) buffer) % PTTTL_DMA_BUFFER_ALIGNMENT))
+    {
+        return -1;
+    }
+
+    driver->generator = generator;
+    driver->buffer = (uint8_t *) buffer;
+    driver->half_samples = half_samples;
+    driver->read_cycle_counter = read_cycle_counter;
+    driver->underrun_count = 0u;
+    driver->finished = 0u;
+    memset(driver->worst_case_cycles, 0, sizeof(driver->worst_case_cycles));
+
+    int ret = ptttl_sample_generator_prefetch(generator);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    ret = _fill_half(driver, PTTTL_DMA_HALF_A);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    return _fill_half(driver, PTTTL_DMA_HALF_B);
+}
+
+/**
+ * @see ptttl_dma_driver.h
+ */
+int ptttl_dma_driver_refill_half_a(ptttl_dma_driver_t *driver)
+{
+    if (NULL == driver)
+    {
+        return -1;
+    }
+
+    return _fill_half(driver, PTTTL_DMA_HALF_A);
+}
+
+/**
+ * @see ptttl_dma_driver.h
+ */
+int ptttl_dma_driver_refill_half_b(ptttl_dma_driver_t *driver)
+{
+    if (NULL == driver)
+    {
+        return -1;
+    }
+
+    return _fill_half(driver, PTTTL_DMA_HALF_B);
+}
+
+/**
+ * @see ptttl_dma_driver.h
+ */
+int ptttl_dma_driver_service(ptttl_dma_driver_t *driver)
+{
+    if (NULL == driver)
+    {
+        return -1;
+    }
+
+    if (1u == driver->finished)
+    {
+        return 1;
+    }
+
+    return ptttl_sample_generator_prefetch(driver->generator);
+}
+
+/**
+ * @see ptttl_dma_driver.h
+ */
+uint32_t ptttl_dma_driver_worst_case_cycles(ptttl_dma_driver_t *driver, ptttl_dma_half_e half)
+{
+    if ((NULL == driver) || (PTTTL_DMA_HALF_COUNT <= half))
+    {
+        return 0u;
+    }
+
+    return driver->worst_case_cycles[half];
+}
+
+/**
+ * @see ptttl_dma_driver.h
+ */
+uint32_t ptttl_dma_driver_underruns(ptttl_dma_driver_t *driver)
+{
+    if (NULL == driver)
+    {
+        return 0u;
+    }
+
+    return driver->underrun_count;
+}
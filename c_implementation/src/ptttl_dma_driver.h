@@ -0,0 +1,177 @@
+/* ptttl_dma_driver.h
+ *
+ * Double-buffer ("ping-pong") driver for feeding the output of ptttl_sample_generator.c
+ * to a DAC or I2S peripheral via DMA. The DMA controller continuously plays a single
+ * buffer that is split into two halves (A and B); while the DMA is playing one half,
+ * the other half is refilled from the half-complete and full-complete interrupts.
+ *
+ * Requires ptttl_parser.c and ptttl_sample_generator.c
+ *
+ * Requires stdint.h and memset() from string.h
+ *
+ * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
+ *
+ * Erik Nyquist 2025
+ */
+
+#ifndef PTTTL_DMA_DRIVER_H
+#define PTTTL_DMA_DRIVER_H
+
+
+#include <stdint.h>
+#include "ptttl_sample_generator.h"
+
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+
+/**
+ * Required alignment, in bytes, of the sample buffer passed to #ptttl_dma_driver_init.
+ * Set this to whatever your DMA controller requires (e.g. the bus width, or the
+ * cache line size if the buffer lives in cached memory).
+ */
+#ifndef PTTTL_DMA_BUFFER_ALIGNMENT
+#define PTTTL_DMA_BUFFER_ALIGNMENT (4u)
+#endif // PTTTL_DMA_BUFFER_ALIGNMENT
+
+
+/**
+ * Enumerates the two halves of a DMA double buffer
+ */
+typedef enum
+{
+    PTTTL_DMA_HALF_A = 0,  ///< First half of buffer, played first
+    PTTTL_DMA_HALF_B,      ///< Second half of buffer
+    PTTTL_DMA_HALF_COUNT
+} ptttl_dma_half_e;
+
+/**
+ * Represents a DMA double-buffer driver instance
+ */
+typedef struct
+{
+    ptttl_sample_generator_t *generator;        ///< Generator that samples are rendered from
+    uint8_t *buffer;                            ///< Sample buffer, holds both halves back-to-back
+    uint32_t half_samples;                      ///< Number of sample frames in each half of the buffer
+    uint32_t (*read_cycle_counter)(void);       ///< Optional cycle counter, NULL if not used
+    uint32_t worst_case_cycles[PTTTL_DMA_HALF_COUNT]; ///< Most cycles spent refilling each half
+    uint32_t underrun_count;                    ///< No. of refills cut short because a prefetch buffer ran dry
+    uint8_t finished;                           ///< 1 if the generator has no more samples
+} ptttl_dma_driver_t;
+
+
+/**
+ * Initialize a DMA double-buffer driver instance, and fill both halves of the buffer
+ * so that the DMA transfer can be started.
+ *
+ * @param driver              Pointer to driver instance to initialize
+ * @param generator           Pointer to initialized generator object
+ * @param buffer              Pointer to sample buffer to be played by the DMA controller.
+ *                            Must be aligned to #PTTTL_DMA_BUFFER_ALIGNMENT, and must have
+ *                            space for (2 * half_samples) sample frames in the sample
+ *                            format and output channel count selected in the generator
+ *                            configuration.
+ * @param half_samples        Number of sample frames in each half of the buffer. Smaller values
+ *                            mean lower latency, but less time to refill each half.
+ * @param read_cycle_counter  Optional function that returns the current value of a
+ *                            free-running cycle counter (e.g. DWT->CYCCNT on Cortex-M).
+ *                            If provided, the worst-case number of cycles spent refilling
+ *                            each half is recorded (see #ptttl_dma_driver_worst_case_cycles).
+ *                            May be NULL.
+ *
+ * @return 0 if successful, 1 if all samples have been generated already, and -1 if an
+ *         error occurred. Call #ptttl_sample_generator_error for an error description if
+ *         -1 is returned.
+ */
+int ptttl_dma_driver_init(ptttl_dma_driver_t *driver, ptttl_sample_generator_t *generator,
+                          void *buffer, uint32_t half_samples,
+                          uint32_t (*read_cycle_counter)(void));
+
+/**
+ * Refill the first half of the buffer with exactly 'half_samples' samples. Call this
+ * from the DMA half-complete interrupt handler, i.e. when the DMA controller has finished
+ * reading the first half and is reading the second half. Once the generator has no more
+ * samples, the remainder of the half is filled with silence.
+ *
+ * Does not block, does not call the parser, and does not touch any state other than the
+ * driver and generator instances. Only notes that have already been parsed by
+ * #ptttl_dma_driver_service are used (see #ptttl_sample_generator_generate_no_parse). If
+ * the prefetch buffer of a channel runs dry because #ptttl_dma_driver_service was not
+ * called often enough, the remainder of the half is filled with silence, the underrun
+ * counter is incremented (see #ptttl_dma_driver_underruns), and playback continues from
+ * the same point in the song after the next call to #ptttl_dma_driver_service.
+ *
+ * @param driver  Pointer to initialized driver instance
+ *
+ * @return 0 if successful, 1 if all samples have been generated, and -1 if an error
+ *         occurred. Call #ptttl_sample_generator_error for an error description if -1
+ *         is returned.
+ */
+int ptttl_dma_driver_refill_half_a(ptttl_dma_driver_t *driver);
+
+/**
+ * Refill the second half of the buffer with exactly 'half_samples' samples. Call this
+ * from the DMA full-complete interrupt handler, i.e. when the DMA controller has finished
+ * reading the second half and has wrapped around to the first half. See
+ * #ptttl_dma_driver_refill_half_a.
+ *
+ * @param driver  Pointer to initialized driver instance
+ *
+ * @return 0 if successful, 1 if all samples have been generated, and -1 if an error
+ *         occurred. Call #ptttl_sample_generator_error for an error description if -1
+ *         is returned.
+ */
+int ptttl_dma_driver_refill_half_b(ptttl_dma_driver_t *driver);
+
+/**
+ * Parse upcoming notes ahead of time, outside of the DMA interrupts (see
+ * #ptttl_sample_generator_prefetch). Call this from thread context (e.g. the main
+ * loop) at least once for every #PTTTL_NOTE_PREFETCH_COUNT notes that can end on a
+ * single channel, e.g. once after each refill, so that the refill functions never
+ * have to parse notes themselves.
+ *
+ * This function and the refill functions must not run at the same time, so mask the
+ * DMA interrupts while calling it; it only runs for as long as it takes to parse up to
+ * #PTTTL_NOTE_PREFETCH_COUNT notes per channel.
+ *
+ * @param driver  Pointer to initialized driver instance
+ *
+ * @return 0 if successful, 1 if all samples have been generated, and -1 if an error
+ *         occurred. Call #ptttl_sample_generator_error for an error description if -1
+ *         is returned.
+ */
+int ptttl_dma_driver_service(ptttl_dma_driver_t *driver);
+
+/**
+ * Get the largest number of cycles spent refilling a single half of the buffer, as
+ * measured by the cycle counter passed to #ptttl_dma_driver_init. This must be less
+ * than the number of cycles it takes the DMA controller to play one half of the buffer,
+ * with some margin, for playback to be glitch-free. Parsing is never included, since the
+ * refill functions do not call the parser.
+ *
+ * @param driver  Pointer to initialized driver instance
+ * @param half    Buffer half to get the worst-case cycle count for
+ *
+ * @return Worst-case cycle count, or 0 if no cycle counter was provided
+ */
+uint32_t ptttl_dma_driver_worst_case_cycles(ptttl_dma_driver_t *driver, ptttl_dma_half_e half);
+
+/**
+ * Get the number of times a refill was cut short and padded with silence because the
+ * prefetch buffer of a channel ran dry, i.e. #ptttl_dma_driver_service was not called
+ * often enough
+ *
+ * @param driver  Pointer to initialized driver instance
+ *
+ * @return Underrun count, or 0 if driver is NULL
+ */
+uint32_t ptttl_dma_driver_underruns(ptttl_dma_driver_t *driver);
+
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // PTTTL_DMA_DRIVER_H
@@ -0,0 +1,293 @@
+/* ptttl_event_iterator.c
+ *
+ * Merges the notes of all channels parsed by ptttl_parser.c into a single stream of
+ * note-on and note-off events in time order, for sequencers, MIDI exporters, or
+ * anything else that needs to follow all channels at once. No dynamic memory allocation.
+ *
+ * Requires ptttl_parser.c
+ *
+ * Requires stdint.h and stddef.h
+ *
+ * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
+ *
+ * Erik Nyquist 2025
+ */
+
+#include "ptttl_event_iterator.h"
+
+
+// Store an error message for reporting by ptttl_event_iterator_error()
+#define ERROR(_parser, _msg)                                \
+{                                                           \
+    _error.error_message = _msg;                            \
+    _error.line = _parser->active_stream->line;             \
+    _error.column = _parser->active_stream->column;         \
+}
+
+
+// Static storage for description of last error
+static ptttl_parser_error_t _error = {.line = 0u, .column = 0u, .error_message=NULL};
+
+
+/**
+ * Check whether the next event of one channel comes before the next event of another
+ * channel; earlier events first, then note-off events before note-on events, and then
+ * lower channel indices first
+ *
+ * @param iterator  Pointer to iterator object
+ * @param chan_a    Index of first channel
+ * @param chan_b    Index of second channel
+ *
+ * @return 1 if the next event of chan_a comes first, 0 otherwise
+ */
+static int _event_before(ptttl_event_iterator_t *iterator, uint32_t chan_a, uint32_t chan_b)
+{
+    ptttl_event_cursor_t *a = &iterator->cursors[chan_a];
+    ptttl_event_cursor_t *b = &iterator->cursors[chan_b];
+
+    if (a->time_ms != b->time_ms)
+    {
+        return a->time_ms < b->time_ms;
+    }
+
+    if (a->type != b->type)
+    {
+        return PTTTL_EVENT_NOTE_OFF == a->type;
+    }
+
+    return chan_a < chan_b;
+}
+
+/**
+ * Move a heap entry towards the root until its parent comes before it
+ *
+ * @param iterator  Pointer to iterator object
+ * @param index     Index of heap entry to move
+ */
+static void _sift_up(ptttl_event_iterator_t *iterator, uint32_t index)
+{
+    uint32_t *heap = iterator->heap;
+
+    while (index > 0u)
+    {
+        uint32_t parent = (index - 1u) / 2u;
+        if (!_event_before(iterator, heap[index], heap[parent]))
+        {
+            break;
+        }
+
+        uint32_t chan = heap[index];
+        heap[index] = heap[parent];
+        heap[parent] = chan;
+        index = parent;
+    }
+}
+
+/**
+ * Move a heap entry away from the root until it comes before both of its children
+ *
+ * @param iterator  Pointer to iterator object
+ * @param index     Index of heap entry to move
+ */
+static void _sift_down(ptttl_event_iterator_t *iterator, uint32_t index)
+{
+    uint32_t *heap = iterator->heap;
+
+    while (1)
+    {
+        uint32_t first = index;
+        uint32_t left = (2u * index) + 1u;
+        uint32_t right = left + 1u;
+
+        if ((left < iterator->heap_count) && _event_before(iterator, heap[left], heap[first]))
+        {
+            first = left;
+        }
+
+        if ((right < iterator->heap_count) && _event_before(iterator, heap[right], heap[first]))
+        {
+            first = right;
+        }
+
+        if (first == index)
+        {
+            break;
+        }
+
+        uint32_t chan = heap[index];
+        heap[index] = heap[first];
+        heap[first] = chan;
+        index = first;
+    }
+}
+
+/**
+ * Parse notes for a single channel until the next note that is not a rest, and set the
+ * next event of the channel to the start of that note
+ *
+ * @param iterator     Pointer to iterator object
+ * @param channel_idx  Index of channel to parse notes for
+ * @param time_ms      Time at which the next note starts, in milliseconds
+ *
+ * @return 0 if a note was found, 1 if there are no more notes for this channel,
+ *         and -1 if an error occurred
+ */
+static int _next_note_on(ptttl_event_iterator_t *iterator, uint32_t channel_idx, uint32_t time_ms)
+{
+    ptttl_event_cursor_t *cursor = &iterator->cursors[channel_idx];
+
+    while (1)
+    {
+        int ret = ptttl_parse_next(iterator->parser, channel_idx, &cursor->note);
+        if (ret < 0)
+        {
+            _error = ptttl_parser_error(iterator->parser);
+            return ret;
+        }
+        else if (ret == 1)
+        {
+            return 1;
+        }
+
+        if (0u != PTTTL_NOTE_VALUE(&cursor->note))
+        {
+            break;
+        }
+
+        // Rests produce no events, but still take time
+        time_ms += PTTTL_NOTE_DURATION(&cursor->note);
+    }
+
+    cursor->time_ms = time_ms;
+    cursor->type = PTTTL_EVENT_NOTE_ON;
+
+    return 0;
+}
+
+/**
+ * @see ptttl_event_iterator.h
+ */
+ptttl_parser_error_t ptttl_event_iterator_error(void)
+{
+    return _error;
+}
+
+/**
+ * @see ptttl_event_iterator.h
+ */
+int ptttl_event_iterator_init(ptttl_parser_t *parser, ptttl_event_iterator_t *iterator,
+                              void *storage, size_t storage_size)
+{
+    if (NULL == parser)
+    {
+        return -1;
+    }
+
+    if (NULL == iterator)
+    {
+        ERROR(parser, "NULL pointer passed to function");
+        return -1;
+    }
+
+    if (NULL == storage)
+    {
+#if PTTTL_MAX_CHANNELS_PER_FILE > 0
+        storage = iterator->channel_storage;
+        storage_size = sizeof(iterator->channel_storage);
+#else
+        ERROR(parser, "No built-in channel storage, channel storage must be provided");
+        return -1;
+#endif // PTTTL_MAX_CHANNELS_PER_FILE > 0
+    }
+
+    if (storage_size < ptttl_event_iterator_storage_size(parser->channel_count))
+    {
+        ERROR(parser, "Channel storage too small for PTTTL channel count");
+        return -1;
+    }
+
+    // Align start of storage for cursors and heap
+    uint8_t *aligned = (uint8_t *) storage;
+    aligned += (sizeof(uint32_t) - ((uintptr_t) aligned % sizeof(uint32_t))) % sizeof(uint32_t);
+
+    iterator->parser = parser;
+    iterator->cursors = (ptttl_event_cursor_t *) aligned;
+    iterator->heap = (uint32_t *) &aligned[sizeof(ptttl_event_cursor_t) * parser->channel_count];
+    iterator->heap_count = 0u;
+
+    for (uint32_t chan = 0u; chan < parser->channel_count; chan++)
+    {
+        int ret = _next_note_on(iterator, chan, 0u);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        else if (ret == 1)
+        {
+            continue;
+        }
+
+        iterator->heap[iterator->heap_count] = chan;
+        iterator->heap_count += 1u;
+        _sift_up(iterator, iterator->heap_count - 1u);
+    }
+
+    return 0;
+}
+
+/**
+ * @see ptttl_event_iterator.h
+ */
+size_t ptttl_event_iterator_storage_size(uint32_t channel_count)
+{
+    return PTTTL_EVENT_ITERATOR_STORAGE_SIZE(channel_count);
+}
+
+/**
+ * @see ptttl_event_iterator.h
+ */
+int ptttl_event_next(ptttl_event_iterator_t *iterator, ptttl_event_t *event)
+{
+    if ((NULL == iterator) || (NULL == event))
+    {
+        return -1;
+    }
+
+    if (0u == iterator->heap_count)
+    {
+        return 1;
+    }
+
+    uint32_t chan = iterator->heap[0];
+    ptttl_event_cursor_t *cursor = &iterator->cursors[chan];
+
+    event->time_ms = cursor->time_ms;
+    event->channel = chan;
+    event->type = cursor->type;
+    event->note = cursor->note;
+
+    if (PTTTL_EVENT_NOTE_ON == cursor->type)
+    {
+        // Note stops when its duration has elapsed
+        cursor->time_ms += PTTTL_NOTE_DURATION(&cursor->note);
+        cursor->type = PTTTL_EVENT_NOTE_OFF;
+    }
+    else
+    {
+        int ret = _next_note_on(iterator, chan, cursor->time_ms);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        else if (ret == 1)
+        {
+            // No more events for this channel, replace it with the last heap entry
+            iterator->heap_count -= 1u;
+            iterator->heap[0] = iterator->heap[iterator->heap_count];
+        }
+    }
+
+    _sift_down(iterator, 0u);
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+/* ptttl_event_iterator.h
+ *
+ * Merges the notes of all channels parsed by ptttl_parser.c into a single stream of
+ * note-on and note-off events in time order, for sequencers, MIDI exporters, or
+ * anything else that needs to follow all channels at once. No dynamic memory allocation.
+ *
+ * Requires ptttl_parser.c
+ *
+ * Requires stdint.h and stddef.h
+ *
+ * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
+ *
+ * Erik Nyquist 2025
+ */
+
+#ifndef PTTTL_EVENT_ITERATOR_H
+#define PTTTL_EVENT_ITERATOR_H
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ptttl_parser.h"
+
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+
+/**
+ * Enumerates all event types produced by #ptttl_event_next
+ */
+typedef enum
+{
+    PTTTL_EVENT_NOTE_OFF = 0,     ///< A note has stopped sounding
+    PTTTL_EVENT_NOTE_ON           ///< A note has started sounding
+} ptttl_event_type_e;
+
+/**
+ * A single note-on or note-off event
+ */
+typedef struct
+{
+    uint32_t time_ms;             ///< Time of the event, in milliseconds from the start of the song
+    uint32_t channel;             ///< Index of the PTTTL channel the note was parsed from
+    ptttl_event_type_e type;      ///< Event type
+    ptttl_output_note_t note;     ///< The note that has started or stopped sounding
+} ptttl_event_t;
+
+/**
+ * Next event of a single channel, waiting to be merged with the other channels
+ */
+typedef struct
+{
+    ptttl_output_note_t note;     ///< Note that the next event belongs to
+    uint32_t time_ms;             ///< Time of the next event, in milliseconds
+    ptttl_event_type_e type;      ///< Type of the next event
+} ptttl_event_cursor_t;
+
+/**
+ * Number of bytes of channel storage needed by an event iterator for a given number of
+ * channels (see #ptttl_event_iterator_init). Can be used to size static buffers at
+ * compile time. Includes room for aligning the start of the storage.
+ */
+#define PTTTL_EVENT_ITERATOR_STORAGE_SIZE(channel_count)                           \
+    ((sizeof(uint32_t) - 1u) +                                                     \
+     ((size_t) (channel_count) * (sizeof(ptttl_event_cursor_t) + sizeof(uint32_t))))
+
+/**
+ * Holds the state of an event iterator. Channels are merged with a binary min-heap,
+ * keyed on the time of the next event of each channel, so producing each event takes
+ * time in proportion to the log of the number of channels.
+ */
+typedef struct
+{
+    ptttl_parser_t *parser;       ///< Parser that notes are read from
+    ptttl_event_cursor_t *cursors; ///< Next event of each channel
+    uint32_t *heap;               ///< Indices of channels that have events left, as a min-heap
+    uint32_t heap_count;          ///< No. of entries in heap
+#if PTTTL_MAX_CHANNELS_PER_FILE > 0
+    /// Built-in channel storage, used if no channel storage is provided
+    uint32_t channel_storage[(PTTTL_EVENT_ITERATOR_STORAGE_SIZE(PTTTL_MAX_CHANNELS_PER_FILE) + 3u) / sizeof(uint32_t)];
+#endif // PTTTL_MAX_CHANNELS_PER_FILE > 0
+} ptttl_event_iterator_t;
+
+
+/**
+ * Return error info after an event iterator function has returned -1
+ *
+ * @return  Object describing the error that occurred. error_message field will be NULL
+ *          if no error has occurred.
+ */
+ptttl_parser_error_t ptttl_event_iterator_error(void);
+
+/**
+ * Initialize an event iterator for an initialized parser. The iterator reads notes
+ * with #ptttl_parse_next, so the parser must not have been used to parse any notes
+ * yet, and must not be used for anything else while the iterator is in use.
+ *
+ * @param parser         Pointer to initialized parser object
+ * @param iterator       Pointer to iterator object to initialize
+ * @param storage        Optional storage for the state of each channel, with no alignment
+ *                       requirement, which must remain valid as long as the iterator is in
+ *                       use. If NULL, the storage built into ptttl_event_iterator_t is used,
+ *                       which has room for #PTTTL_MAX_CHANNELS_PER_FILE channels.
+ * @param storage_size   Size of storage in bytes, must be at least as large as
+ *                       #ptttl_event_iterator_storage_size reports for the channel count
+ *
+ * @return 0 if successful, -1 if an error occurred. Call #ptttl_event_iterator_error for
+ *         an error description if -1 is returned.
+ */
+int ptttl_event_iterator_init(ptttl_parser_t *parser, ptttl_event_iterator_t *iterator,
+                              void *storage, size_t storage_size);
+
+/**
+ * Return the number of bytes of channel storage needed by an event iterator for a
+ * given number of PTTTL channels
+ *
+ * @param channel_count  Number of PTTTL channels
+ *
+ * @return Channel storage size in bytes
+ */
+size_t ptttl_event_iterator_storage_size(uint32_t channel_count);
+
+/**
+ * Produce the next note-on or note-off event, across all channels, in time order.
+ * Event times are the sums of note durations in milliseconds, as reported by the parser.
+ * Rests do not produce any events. Events that happen at the same time are produced with
+ * all note-off events first, and otherwise in channel order, so that a note which follows
+ * another note on the same channel always starts after the previous note has stopped.
+ *
+ * @param iterator       Pointer to initialized iterator object
+ * @param event          Pointer to location to store the next event
+ *
+ * @return 0 if an event was produced, 1 if there are no more events, and -1 if an error
+ *         occurred. Call #ptttl_event_iterator_error for an error description if -1 is
+ *         returned.
+ */
+int ptttl_event_next(ptttl_event_iterator_t *iterator, ptttl_event_t *event);
+
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // PTTTL_EVENT_ITERATOR_H
@@ -0,0 +1,202 @@
+/* ptttl_output_sink.c
+ *
+ * Generic interface for writing encoded audio data (e.g. the output of ptttl_to_wav.c)
+ * to an arbitrary destination, along with built-in implementations for writing to stdio
+ * streams, POSIX file descriptors, caller-provided memory buffers and callback functions.
+ *
+ * Requires stdint.h, stddef.h, memcpy() from string.h, fwrite/fseek/fflush from stdio.h
+ * (only if PTTTL_OUTPUT_SINK_STDIO_SUPPORT is 1), and write/lseek from unistd.h (only if
+ * PTTTL_OUTPUT_SINK_FD_SUPPORT is 1)
+ *
+ * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
+ *
+ * Erik Nyquist 2025
+ */
+
+#include <string.h>
+
+#include "ptttl_output_sink.h"
+
+#if PTTTL_OUTPUT_SINK_FD_SUPPORT
+#include <errno.h>
+#include <unistd.h>
+#endif // PTTTL_OUTPUT_SINK_FD_SUPPORT
+
+
+// ptttl_output_sink_t write callback for memory buffers
+static int _memory_write(void *context, const void *data, size_t size)
+{
+    ptttl_output_sink_memory_t *memory = (ptttl_output_sink_memory_t *) context;
+
+    if (size > (memory->size - memory->position))
+    {
+        return -1;
+    }
+
+    memcpy(&memory->buffer[memory->position], data, size);
+    memory->position += size;
+
+    if (memory->position > memory->length)
+    {
+        memory->length = memory->position;
+    }
+
+    return 0;
+}
+
+// ptttl_output_sink_t seek callback for memory buffers
+static int _memory_seek(void *context, uint64_t position)
+{
+    ptttl_output_sink_memory_t *memory = (ptttl_output_sink_memory_t *) context;
+
+    if (position > (uint64_t) memory->length)
+    {
+        return -1;
+    }
+
+    memory->position = (size_t) position;
+    return 0;
+}
+
+/**
+ * @see ptttl_output_sink.h
+ */
+int ptttl_output_sink_init_memory(ptttl_output_sink_t *sink, ptttl_output_sink_memory_t *memory,
+                                  void *buffer, size_t size)
+{
+    if ((NULL == sink) || (NULL == memory) || (NULL == buffer))
+    {
+        return -1;
+    }
+
+    memory->buffer = (uint8_t *) buffer;
+    memory->size = size;
+    memory->position = 0u;
+    memory->length = 0u;
+
+    sink->write = _memory_write;
+    sink->seek = _memory_seek;
+    sink->flush = NULL;
+    sink->context = memory;
+
+    return 0;
+}
+
+/**
+ * @see ptttl_output_sink.h
+ */
+int ptttl_output_sink_init_callback(ptttl_output_sink_t *sink,
+                                    int (*callback)(void *context, const void *data, size_t size),
+                                    void *context)
+{
+    if ((NULL == sink) || (NULL == callback))
+    {
+        return -1;
+    }
+
+    sink->write = callback;
+    sink->seek = NULL;
+    sink->flush = NULL;
+    sink->context = context;
+
+    return 0;
+}
+
+
+#if PTTTL_OUTPUT_SINK_STDIO_SUPPORT
+
+// ptttl_output_sink_t write callback for stdio streams
+static int _stdio_write(void *context, const void *data, size_t size)
+{
+    size_t size_written = fwrite(data, 1u, size, (FILE *) context);
+    return (size == size_written) ? 0 : -1;
+}
+
+// ptttl_output_sink_t seek callback for stdio streams
+static int _stdio_seek(void *context, uint64_t position)
+{
+    return (0 == fseek((FILE *) context, (long) position, SEEK_SET)) ? 0 : -1;
+}
+
+// ptttl_output_sink_t flush callback for stdio streams
+static int _stdio_flush(void *context)
+{
+    return (0 == fflush((FILE *) context)) ? 0 : -1;
+}
+
+/**
+ * @see ptttl_output_sink.h
+ */
+int ptttl_output_sink_init_stdio(ptttl_output_sink_t *sink, FILE *stream)
+{
+    if ((NULL == sink) || (NULL == stream))
+    {
+        return -1;
+    }
+
+    sink->write = _stdio_write;
+    sink->seek = _stdio_seek;
+    sink->flush = _stdio_flush;
+    sink->context = stream;
+
+    return 0;
+}
+
+#endif // PTTTL_OUTPUT_SINK_STDIO_SUPPORT
+
+
+#if PTTTL_OUTPUT_SINK_FD_SUPPORT
+
+// ptttl_output_sink_t write callback for file descriptors
+static int _fd_write(void *context, const void *data, size_t size)
+{
+    int fd = (int) (intptr_t) context;
+    const uint8_t *bytes = (const uint8_t *) data;
+
+    // write() may write less than requested (e.g. for pipes and sockets), so loop until done
+    while (size > 0u)
+    {
+        ssize_t size_written = write(fd, bytes, size);
+        if (size_written < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+
+            return -1;
+        }
+
+        bytes += size_written;
+        size -= (size_t) size_written;
+    }
+
+    return 0;
+}
+
+// ptttl_output_sink_t seek callback for file descriptors
+static int _fd_seek(void *context, uint64_t position)
+{
+    int fd = (int) (intptr_t) context;
+    return (lseek(fd, (off_t) position, SEEK_SET) < 0) ? -1 : 0;
+}
+
+/**
+ * @see ptttl_output_sink.h
+ */
+int ptttl_output_sink_init_fd(ptttl_output_sink_t *sink, int fd)
+{
+    if ((NULL == sink) || (fd < 0))
+    {
+        return -1;
+    }
+
+    sink->write = _fd_write;
+    sink->seek = _fd_seek;
+    sink->flush = NULL;
+    sink->context = (void *) (intptr_t) fd;
+
+    return 0;
+}
+
+#endif // PTTTL_OUTPUT_SINK_FD_SUPPORT
@@ -0,0 +1,173 @@
+/* ptttl_output_sink.h
+ *
+ * Generic interface for writing encoded audio data (e.g. the output of ptttl_to_wav.c)
+ * to an arbitrary destination, along with built-in implementations for writing to stdio
+ * streams, POSIX file descriptors, caller-provided memory buffers and callback functions.
+ *
+ * Requires stdint.h, stddef.h, memcpy() from string.h, fwrite/fseek/fflush from stdio.h
+ * (only if PTTTL_OUTPUT_SINK_STDIO_SUPPORT is 1), and write/lseek from unistd.h (only if
+ * PTTTL_OUTPUT_SINK_FD_SUPPORT is 1)
+ *
+ * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
+ *
+ * Erik Nyquist 2025
+ */
+
+#ifndef PTTTL_OUTPUT_SINK_H
+#define PTTTL_OUTPUT_SINK_H
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+
+/**
+ * Set to 0 to remove the built-in sink for stdio streams (FILE pointers), for
+ * platforms that do not provide stdio.h
+ */
+#ifndef PTTTL_OUTPUT_SINK_STDIO_SUPPORT
+#define PTTTL_OUTPUT_SINK_STDIO_SUPPORT (1)
+#endif // PTTTL_OUTPUT_SINK_STDIO_SUPPORT
+
+/**
+ * Set to 1 to add the built-in sink for POSIX file descriptors, on platforms that
+ * provide unistd.h. Disabled by default, so that the library only needs stdio.h
+ * and stdint.h unless asked otherwise.
+ */
+#ifndef PTTTL_OUTPUT_SINK_FD_SUPPORT
+#define PTTTL_OUTPUT_SINK_FD_SUPPORT (0)
+#endif // PTTTL_OUTPUT_SINK_FD_SUPPORT
+
+
+#if PTTTL_OUTPUT_SINK_STDIO_SUPPORT
+#include <stdio.h>
+#endif // PTTTL_OUTPUT_SINK_STDIO_SUPPORT
+
+
+/**
+ * Holds function pointers that make up an interface for writing output data to
+ * various locations (e.g. to a file, or to memory)
+ */
+typedef struct
+{
+    /**
+     * Callback function to write data to the output. All data must be written.
+     *
+     * @param context  User context pointer, set in the 'context' field of this struct
+     * @param data     Pointer to data to write
+     * @param size     Number of bytes to write
+     *
+     * @return 0 if successful, -1 if an error occurred
+     */
+    int (*write)(void *context, const void *data, size_t size);
+
+    /**
+     * Optional callback function to seek to an absolute position within the output,
+     * for writers that need to go back and update data that was already written. Set
+     * to NULL if the output is not seekable (e.g. a pipe or socket); ptttl_to_wav.c
+     * never requires this callback.
+     *
+     * @param context   User context pointer, set in the 'context' field of this struct
+     * @param position  0-based byte position to seek to
+     *
+     * @return 0 if successful, -1 if an error occurred
+     */
+    int (*seek)(void *context, uint64_t position);
+
+    /**
+     * Optional callback function to flush any data that has been buffered by the
+     * output. Called once after all data has been written. Set to NULL if not needed.
+     *
+     * @param context   User context pointer, set in the 'context' field of this struct
+     *
+     * @return 0 if successful, -1 if an error occurred
+     */
+    int (*flush)(void *context);
+
+    void *context; ///< User context pointer, passed to all callback functions
+} ptttl_output_sink_t;
+
+
+/**
+ * Holds the state of a built-in sink that writes to a caller-provided memory buffer
+ */
+typedef struct
+{
+    uint8_t *buffer;   ///< Caller-provided buffer to write output data to
+    size_t size;       ///< Size of caller-provided buffer in bytes
+    size_t position;   ///< Current write position within the buffer
+    size_t length;     ///< Number of bytes of valid output data in the buffer
+} ptttl_output_sink_memory_t;
+
+
+/**
+ * Initialize a sink that writes to a caller-provided memory buffer. Writes that
+ * would overflow the buffer fail. Seeking is supported. After writing is complete,
+ * the number of bytes of output data is available in the 'length' field of the
+ * ptttl_output_sink_memory_t object.
+ *
+ * @param sink     Pointer to sink object to initialize
+ * @param memory   Pointer to memory sink state object, must remain valid as long
+ *                 as the sink is in use
+ * @param buffer   Pointer to buffer to write output data to
+ * @param size     Size of buffer in bytes
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+int ptttl_output_sink_init_memory(ptttl_output_sink_t *sink, ptttl_output_sink_memory_t *memory,
+                                  void *buffer, size_t size);
+
+/**
+ * Initialize a sink that passes all output data to a single callback function,
+ * e.g. to send it over a network connection as it is produced. Seeking is not
+ * supported.
+ *
+ * @param sink      Pointer to sink object to initialize
+ * @param callback  Callback function to pass output data to, see the 'write' field
+ *                  of ptttl_output_sink_t
+ * @param context   User context pointer, passed to the callback function
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+int ptttl_output_sink_init_callback(ptttl_output_sink_t *sink,
+                                    int (*callback)(void *context, const void *data, size_t size),
+                                    void *context);
+
+#if PTTTL_OUTPUT_SINK_STDIO_SUPPORT
+/**
+ * Initialize a sink that writes to an open stdio stream. Seeking is only attempted
+ * if requested by the writer, so the stream can be a pipe or stdout.
+ *
+ * @param sink     Pointer to sink object to initialize
+ * @param stream   Stream to write to, must be opened for writing in binary mode
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+int ptttl_output_sink_init_stdio(ptttl_output_sink_t *sink, FILE *stream);
+#endif // PTTTL_OUTPUT_SINK_STDIO_SUPPORT
+
+#if PTTTL_OUTPUT_SINK_FD_SUPPORT
+/**
+ * Initialize a sink that writes to an open POSIX file descriptor, with no buffering
+ * beyond whatever the caller's chunk size is. Seeking is only attempted if requested
+ * by the writer, so the file descriptor can be a pipe or socket.
+ *
+ * @param sink     Pointer to sink object to initialize
+ * @param fd       File descriptor to write to, must be open for writing
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+int ptttl_output_sink_init_fd(ptttl_output_sink_t *sink, int fd);
+#endif // PTTTL_OUTPUT_SINK_FD_SUPPORT
+
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // PTTTL_OUTPUT_SINK_H
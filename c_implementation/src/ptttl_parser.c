@@ -35,6 +35,9 @@
 // Helper macro, checks if a character is a digit
 #define IS_DIGIT(c) (((c) >= '0') && ((c) <= '9'))
 
+// Helper macro, checks if a character is a letter
+#define IS_LETTER(c) ((((c) >= 'a') && ((c) <= 'z')) || (((c) >= 'A') && ((c) <= 'Z')))
+
 #define CHECK_SHARPONLY(string, size, notechar, val, sharpval) \
 {                                                              \
     if (notechar == string[0])                                 \
@@ -793,23 +796,44 @@ ptttl_parser_error_t ptttl_parser_error(ptttl_parser_t *parser)
 }
 
 /**
- * @see ptttl_parser.h
+ * Reset the state of a parser object to the start of the input text, with no
+ * channels and no error
+ *
+ * @param parser         Pointer to parser object to reset
  */
-int ptttl_parse_init(ptttl_parser_t *parser, ptttl_parser_input_iface_t iface)
+static void _reset_parser(ptttl_parser_t *parser)
 {
-    if (NULL == parser)
-    {
-        return -1;
-    }
-
     parser->stream.line = 1u;
     parser->stream.column = 1u;
     parser->stream.position = 0u;
     parser->stream.have_saved_char = 0u;
+    parser->stream.block = 0u;
+    parser->first_block = parser->stream;
+    parser->active_stream = &parser->stream;
+    parser->channels = NULL;
+    parser->max_channels = 0u;
     parser->channel_count = 0u;
     parser->error.line = 0;
     parser->error.column = 0;
     parser->error.error_message = NULL;
+}
+
+/**
+ * Initialize a parser object that has been reset with _reset_parser, parse the name
+ * and settings sections, and find the starting position of each channel in the first block
+ *
+ * @param parser         Pointer to parser object to initialize
+ * @param iface          Input interface for reading PTTTL/RTTTL source text
+ * @param channels       Pointer to channel storage, or NULL to only count channels
+ * @param max_channels   Number of channels that channel storage has room for
+ *
+ * @return  0 if successful, -1 otherwise
+ */
+static int _parse_init(ptttl_parser_t *parser, ptttl_parser_input_iface_t iface,
+                       ptttl_parser_input_stream_t *channels, uint32_t max_channels)
+{
+    parser->channels = channels;
+    parser->max_channels = max_channels;
 
     if ((NULL == iface.read) || (NULL == iface.seek))
     {
@@ -867,12 +891,15 @@ int ptttl_parse_init(ptttl_parser_t *parser, ptttl_parser_input_iface_t iface)
         ret = _eat_all_nonvisible_chars(parser);
         if (0 == ret)
         {
-            ptttl_parser_input_stream_t *chan = &parser->channels[parser->channel_count];
-            chan->position = parser->active_stream->position;
-            chan->line = parser->active_stream->line;
-            chan->column = parser->active_stream->column;
-            chan->have_saved_char = parser->active_stream->have_saved_char;
-            chan->saved_char = parser->active_stream->saved_char;
+            if (0u == parser->channel_count)
+            {
+                parser->first_block = *parser->active_stream;
+            }
+
+            if (NULL != parser->channels)
+            {
+                parser->channels[parser->channel_count] = *parser->active_stream;
+            }
 
             parser->channel_count += 1u;
 
@@ -883,7 +910,7 @@ int ptttl_parse_init(ptttl_parser_t *parser, ptttl_parser_input_iface_t iface)
 
                 if ('|' == nextchar)
                 {
-                    if (PTTTL_MAX_CHANNELS_PER_FILE == parser->channel_count)
+                    if ((NULL != parser->channels) && (parser->max_channels == parser->channel_count))
                     {
                         ERROR(parser, "Exceeded maximum channel count");
                         return -1;
@@ -902,6 +929,271 @@ int ptttl_parse_init(ptttl_parser_t *parser, ptttl_parser_input_iface_t iface)
     return 0;
 }
 
+/**
+ * @see ptttl_parser.h
+ */
+int ptttl_parse_init(ptttl_parser_t *parser, ptttl_parser_input_iface_t iface)
+{
+    if (NULL == parser)
+    {
+        return -1;
+    }
+
+    _reset_parser(parser);
+
+#if PTTTL_MAX_CHANNELS_PER_FILE > 0
+    return _parse_init(parser, iface, parser->channel_storage, PTTTL_MAX_CHANNELS_PER_FILE);
+#else
+    (void) iface;
+    ERROR(parser, "No built-in channel storage, see ptttl_parse_init_with_storage");
+    return -1;
+#endif // PTTTL_MAX_CHANNELS_PER_FILE > 0
+}
+
+/**
+ * @see ptttl_parser.h
+ */
+int ptttl_parse_init_with_storage(ptttl_parser_t *parser, ptttl_parser_input_iface_t iface,
+                                  void *storage, size_t storage_size)
+{
+    if (NULL == parser)
+    {
+        return -1;
+    }
+
+    _reset_parser(parser);
+
+    if (NULL == storage)
+    {
+        ERROR(parser, "NULL channel storage provided");
+        return -1;
+    }
+
+    if (0u != ((uintptr_t) storage % sizeof(uint32_t)))
+    {
+        ERROR(parser, "Channel storage is not aligned");
+        return -1;
+    }
+
+    size_t max_channels = storage_size / sizeof(ptttl_parser_input_stream_t);
+    if (0u == max_channels)
+    {
+        ERROR(parser, "Channel storage too small for a single channel");
+        return -1;
+    }
+
+    if (max_channels > UINT32_MAX)
+    {
+        max_channels = UINT32_MAX;
+    }
+
+    return _parse_init(parser, iface, (ptttl_parser_input_stream_t *) storage, (uint32_t) max_channels);
+}
+
+/**
+ * @see ptttl_parser.h
+ */
+int ptttl_parse_count_channels(ptttl_parser_t *parser, ptttl_parser_input_iface_t iface,
+                               uint32_t *channel_count)
+{
+    if (NULL == parser)
+    {
+        return -1;
+    }
+
+    _reset_parser(parser);
+
+    if (NULL == channel_count)
+    {
+        ERROR(parser, "NULL output pointer provided");
+        return -1;
+    }
+
+    int ret = _parse_init(parser, iface, NULL, 0u);
+    if (0 != ret)
+    {
+        return ret;
+    }
+
+    *channel_count = parser->channel_count;
+
+    // No channel storage, so make sure the parser can't be used for parsing notes
+    parser->channel_count = 0u;
+
+    // Rewind input, ready for the parser to be initialized
+    parser->active_stream = &parser->stream;
+    ret = _seek_wrapper(parser, 0u);
+    CHECK_IFACE_RET(parser, ret);
+
+    return 0;
+}
+
+/**
+ * @see ptttl_parser.h
+ */
+size_t ptttl_parser_storage_size(uint32_t channel_count)
+{
+    return PTTTL_PARSER_STORAGE_SIZE(channel_count);
+}
+
+/**
+ * Store the fingerprint of a block that has been scanned by ptttl_parse_block_fingerprints
+ *
+ * @param parser        Pointer to parser object
+ * @param fingerprints  Pointer to fingerprint storage, or NULL to only count blocks
+ * @param max_blocks    Number of fingerprints that 'fingerprints' has room for
+ * @param count         Pointer to no. of blocks scanned so far, incremented on success
+ * @param hash          Fingerprint of the block
+ *
+ * @return  0 if successful, -1 if there is no room for the fingerprint
+ */
+static int _store_block_fingerprint(ptttl_parser_t *parser, uint64_t *fingerprints,
+                                    uint32_t max_blocks, uint32_t *count, uint64_t hash)
+{
+    if (NULL != fingerprints)
+    {
+        if (*count == max_blocks)
+        {
+            ERROR(parser, "Too many blocks for fingerprint storage");
+            return -1;
+        }
+
+        fingerprints[*count] = hash;
+    }
+
+    *count += 1u;
+    return 0;
+}
+
+/**
+ * Hash the visible text of each block, starting from the current input position
+ *
+ * @param parser        Pointer to parser object
+ * @param fingerprints  Pointer to fingerprint storage, or NULL to only count blocks
+ * @param max_blocks    Number of fingerprints that 'fingerprints' has room for
+ * @param block_count   Pointer to location to store the number of blocks
+ *
+ * @return  0 if successful, -1 otherwise
+ */
+static int _scan_block_fingerprints(ptttl_parser_t *parser, uint64_t *fingerprints,
+                                    uint32_t max_blocks, uint32_t *block_count)
+{
+    uint32_t count = 0u;
+    uint64_t hash = FNV1A_64_OFFSET;
+    uint8_t block_empty = 1u;
+    uint8_t in_comment = 0u;
+    char prevchar = '\n';
+    char nextchar = '\0';
+    int ret = 0;
+
+    while ((ret = _readchar_wrapper(parser, &nextchar)) == 0)
+    {
+        ADVANCE_LINE_COLUMN(parser, nextchar);
+
+        if (1u == in_comment)
+        {
+            if ('\n' == nextchar)
+            {
+                in_comment = 0u;
+                prevchar = nextchar;
+            }
+
+            continue;
+        }
+
+        if (IS_WHITESPACE(nextchar))
+        {
+            prevchar = nextchar;
+            continue;
+        }
+
+        // '#' is part of a note name if it follows a letter, and starts a comment otherwise
+        if (('#' == nextchar) && !IS_LETTER(prevchar))
+        {
+            in_comment = 1u;
+            continue;
+        }
+
+        prevchar = nextchar;
+
+        if (';' == nextchar)
+        {
+            if (0 != _store_block_fingerprint(parser, fingerprints, max_blocks, &count, hash))
+            {
+                return -1;
+            }
+
+            hash = FNV1A_64_OFFSET;
+            block_empty = 1u;
+        }
+        else
+        {
+            hash = (hash ^ (uint8_t) nextchar) * FNV1A_64_PRIME;
+            block_empty = 0u;
+        }
+    }
+
+    if (0 > ret)
+    {
+        ERROR(parser, "interface callback returned -1");
+        return -1;
+    }
+
+    // The last block does not need to be terminated by ';'
+    if (0u == block_empty)
+    {
+        if (0 != _store_block_fingerprint(parser, fingerprints, max_blocks, &count, hash))
+        {
+            return -1;
+        }
+    }
+
+    *block_count = count;
+    return 0;
+}
+
+/**
+ * @see ptttl_parser.h
+ */
+int ptttl_parse_block_fingerprints(ptttl_parser_t *parser, uint64_t *fingerprints,
+                                   uint32_t max_blocks, uint32_t *block_count)
+{
+    if (NULL == parser)
+    {
+        return -1;
+    }
+
+    if (NULL == block_count)
+    {
+        ERROR(parser, "NULL output pointer provided");
+        return -1;
+    }
+
+    if (0u == parser->channel_count)
+    {
+        ERROR(parser, "PTTTL parser object has a channel count of 0");
+        return -1;
+    }
+
+    // Scan with a copy of the input stream for the first block, so that no channel moves
+    ptttl_parser_input_stream_t scan_stream = parser->first_block;
+    parser->active_stream = &scan_stream;
+
+    int ret = _seek_wrapper(parser, scan_stream.position);
+    if (0 == ret)
+    {
+        ret = _scan_block_fingerprints(parser, fingerprints, max_blocks, block_count);
+    }
+    else
+    {
+        ERROR(parser, "interface callback returned -1");
+        ret = -1;
+    }
+
+    parser->active_stream = &parser->stream;
+    return ret;
+}
+
 /**
  * Eat input until we reach the first note of the given channel in the next block
  *
@@ -928,6 +1220,8 @@ static int _jump_to_next_block(ptttl_parser_t *parser, uint32_t channel_idx, uin
         }
     }
 
+    parser->active_stream->block += 1u;
+
     ret = _eat_all_nonvisible_chars(parser);
     CHECK_IFACE_RET_EOF(parser, ret);
 
@@ -7,7 +7,7 @@
  * which is an intermediate representation that can be processed by ptttl_sample_generator.c
  * to obtain PCM audio samples.
  *
- * Requires stdint.h, strtoul() from stdlib.h, and memset() from string.h.
+ * Requires stdint.h, stddef.h, strtoul() from stdlib.h, and memset() from string.h.
  *
  * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
  *
@@ -19,6 +19,7 @@
 
 
 #include <stdint.h>
+#include <stddef.h>
 
 
 #ifdef __cplusplus
@@ -27,9 +28,12 @@
 
 
 /**
- * Maximum number of channels (note lanes) allowed in a single PTTTL file. This
- * setting will significantly affect the size of the ptttl_parser_t and ptttl_sample_generator_t
- * structs-- more channels makes them larger.
+ * Maximum number of channels (note lanes) allowed in a single PTTTL file, when using the
+ * channel storage built into the ptttl_parser_t and ptttl_sample_generator_t structs. This
+ * setting will significantly affect the size of both structs-- more channels makes them
+ * larger. May be set to 0 to remove the built-in channel storage entirely, in which case
+ * channel storage must always be provided by the caller (see #ptttl_parse_init_with_storage,
+ * and the channel_storage field of ptttl_sample_generator_config_t).
  */
 #ifndef PTTTL_MAX_CHANNELS_PER_FILE
 #define PTTTL_MAX_CHANNELS_PER_FILE  (16u)
@@ -46,6 +50,14 @@
 #endif // PTTTL_MAX_NAME_LEN
 
 
+/**
+ * Number of bytes of channel storage needed by #ptttl_parse_init_with_storage for a
+ * given number of channels. Can be used to size static buffers at compile time.
+ */
+#define PTTTL_PARSER_STORAGE_SIZE(channel_count) \
+    (sizeof(ptttl_parser_input_stream_t) * (size_t) (channel_count))
+
+
 // Read vibrato frequency from vibrato settings
 #define PTTTL_NOTE_VIBRATO_FREQ(note) (((note)->vibrato_settings) & 0xffffu)
 
@@ -92,6 +104,7 @@ typedef struct
     uint32_t position;       ///< Current position in input text stream
     uint32_t line;           ///< Current line number in input text
     uint32_t column;         ///< Current column number in input text
+    uint32_t block;          ///< Index of the block that the next note is in, starting from 0
     uint8_t have_saved_char; ///< 1 if a character has been read but not yet used
     char saved_char;         ///< Unused character
 } ptttl_parser_input_stream_t;
@@ -141,7 +154,13 @@ typedef struct
 
 
 /**
- * Tracks current position in input text for all channels
+ * Tracks current position in input text for all channels.
+ *
+ * An initialized parser object holds pointers into itself (its active input stream and,
+ * unless caller-provided channel storage is used, its built-in channel storage), so it
+ * must not be copied or moved after #ptttl_parse_init or #ptttl_parse_init_with_storage.
+ * A copy would keep parsing with the state of the original object. To parse the same
+ * input text again, initialize another parser object instead.
  */
 typedef struct
 {
@@ -155,8 +174,13 @@ typedef struct
     uint32_t channel_count;                     ///< Total number of channels present in input text
     ptttl_parser_input_stream_t *active_stream; ///< Input stream currently being parsed
     ptttl_parser_input_stream_t stream;         ///< Input stream used for 'settings' section
-    ptttl_parser_input_stream_t channels[PTTTL_MAX_CHANNELS_PER_FILE];
+    ptttl_parser_input_stream_t first_block;    ///< Input stream at the start of the first block
+    ptttl_parser_input_stream_t *channels;      ///< Input streams for all channels
+    uint32_t max_channels;                      ///< No. of channels that 'channels' has room for
     ptttl_parser_input_iface_t iface;           ///< Input interface for reading PTTTL source
+#if PTTTL_MAX_CHANNELS_PER_FILE > 0
+    ptttl_parser_input_stream_t channel_storage[PTTTL_MAX_CHANNELS_PER_FILE]; ///< Built-in channel storage
+#endif // PTTTL_MAX_CHANNELS_PER_FILE > 0
 } ptttl_parser_t;
 
 
@@ -183,6 +207,75 @@ ptttl_parser_error_t ptttl_parser_error(ptttl_parser_t *state);
 int ptttl_parse_init(ptttl_parser_t *parser, ptttl_parser_input_iface_t iface);
 
 
+/**
+ * Same as #ptttl_parse_init, but uses caller-provided storage for the state of each
+ * channel instead of the storage built into ptttl_parser_t, so that the number of
+ * channels is not limited by #PTTTL_MAX_CHANNELS_PER_FILE. Use #ptttl_parse_count_channels
+ * and #ptttl_parser_storage_size to find out how much storage a given input text needs.
+ *
+ * @param parser        Pointer to parser object to initialize
+ * @param iface         Input interface for reading PTTTL/RTTTL source text
+ * @param storage       Pointer to channel storage, aligned for uint32_t. Must remain valid
+ *                      for as long as the parser object is in use.
+ * @param storage_size  Size of channel storage in bytes
+ *
+ * @return  0 if successful, -1 otherwise. If -1, use #ptttl_parser_error
+ *          to get detailed error information.
+ */
+int ptttl_parse_init_with_storage(ptttl_parser_t *parser, ptttl_parser_input_iface_t iface,
+                                  void *storage, size_t storage_size);
+
+
+/**
+ * Read the settings section and the first block of a PTTTL/RTTTL input text, and
+ * count the channels, without storing anything for each channel. The input is rewound
+ * to position 0 afterwards. The parser object is only used as scratch space, and must be
+ * initialized with #ptttl_parse_init or #ptttl_parse_init_with_storage afterwards before
+ * it can be used for parsing notes.
+ *
+ * @param parser         Pointer to parser object to use for counting
+ * @param iface          Input interface for reading PTTTL/RTTTL source text
+ * @param channel_count  Pointer to location to store the number of channels
+ *
+ * @return  0 if successful, -1 otherwise. If -1, use #ptttl_parser_error
+ *          to get detailed error information.
+ */
+int ptttl_parse_count_channels(ptttl_parser_t *parser, ptttl_parser_input_iface_t iface,
+                               uint32_t *channel_count);
+
+
+/**
+ * Return the number of bytes of channel storage needed by #ptttl_parse_init_with_storage
+ * for a given number of channels
+ *
+ * @param channel_count  Number of channels
+ *
+ * @return Channel storage size in bytes
+ */
+size_t ptttl_parser_storage_size(uint32_t channel_count);
+
+
+/**
+ * Scan all blocks (';'-separated sections) of the input text, and calculate a fingerprint
+ * of the text of each block, ignoring whitespace and comments. Blocks with the same
+ * fingerprint almost certainly have the same text, so they can be used to find sections
+ * of a song that are repeated verbatim (e.g. a chorus). This does not affect the position
+ * of any channel, so it can be called at any time after the parser has been initialized.
+ *
+ * @param parser        Pointer to initialized parser object
+ * @param fingerprints  Pointer to location to store one fingerprint for each block, in the
+ *                      order that blocks occur in the input text. May be NULL to only
+ *                      count the blocks.
+ * @param max_blocks    Number of fingerprints that 'fingerprints' has room for
+ * @param block_count   Pointer to location to store the number of blocks
+ *
+ * @return  0 if successful, -1 otherwise. If -1, use #ptttl_parser_error
+ *          to get detailed error information.
+ */
+int ptttl_parse_block_fingerprints(ptttl_parser_t *parser, uint64_t *fingerprints,
+                                   uint32_t max_blocks, uint32_t *block_count);
+
+
 /**
  * Read PTTTL/RTTTL source text for the next note of the specified channel, and produce
  * an intermediate representation of the note that can be used to generate audio data.
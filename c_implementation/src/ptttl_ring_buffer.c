@@ -0,0 +1,212 @@
+/* ptttl_ring_buffer.c
+ *
+ * Lock-free single-producer/single-consumer ring buffer of signed 16-bit audio samples,
+ * for real-time playback of the output of ptttl_sample_generator.c. A producer thread
+ * renders samples ahead of time into the ring, and a real-time consumer (e.g. an audio
+ * callback) reads samples out of the ring without ever blocking.
+ *
+ * Requires ptttl_parser.c and ptttl_sample_generator.c
+ *
+ * Requires stdint.h, stdatomic.h (C11) and memset()/memcpy() from string.h
+ *
+ * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
+ *
+ * Erik Nyquist 2025
+ */
+
+#include <string.h>
+#include <stdatomic.h>
+
+#include "ptttl_ring_buffer.h"
+
+
+// Access a shared index or counter of ptttl_ring_buffer_t as an atomic variable
+#define ATOMIC_FIELD(_field) ((_Atomic uint32_t *) &(_field))
+
+_Static_assert(sizeof(_Atomic uint32_t) == sizeof(uint32_t),
+               "Atomic 32-bit integers must be the same size as plain 32-bit integers");
+
+
+/**
+ * Copy samples between a linear buffer and the ring storage, handling wrap-around
+ *
+ * @param ring         Pointer to initialized ring buffer instance
+ * @param index        Free-running ring index of the first sample to copy
+ * @param linear       Pointer to linear buffer
+ * @param num_samples  Number of samples to copy
+ * @param to_ring      If 1, copy from linear buffer into ring, otherwise copy from ring
+ */
+static void _copy_samples(ptttl_ring_buffer_t *ring, uint32_t index, int16_t *linear,
+                          uint32_t num_samples, uint8_t to_ring)
+{
+    uint32_t start = index & (ring->capacity - 1u);
+    uint32_t first = ring->capacity - start;
+    if (first > num_samples)
+    {
+        first = num_samples;
+    }
+
+    if (1u == to_ring)
+    {
+        memcpy(&ring->buffer[start], linear, first * sizeof(int16_t));
+        memcpy(ring->buffer, &linear[first], (num_samples - first) * sizeof(int16_t));
+    }
+    else
+    {
+        memcpy(linear, &ring->buffer[start], first * sizeof(int16_t));
+        memcpy(&linear[first], ring->buffer, (num_samples - first) * sizeof(int16_t));
+    }
+}
+
+/**
+ * @see ptttl_ring_buffer.h
+ */
+int ptttl_ring_buffer_init(ptttl_ring_buffer_t *ring, int16_t *buffer, uint32_t capacity,
+                           uint32_t watermark)
+{
+    if ((NULL == ring) || (NULL == buffer))
+    {
+        return -1;
+    }
+
+    // Capacity must be a non-zero power of 2, so that free-running indices wrap cleanly
+    if ((0u == capacity) || (0u != (capacity & (capacity - 1u))) || (watermark > capacity))
+    {
+        return -1;
+    }
+
+    ring->buffer = buffer;
+    ring->capacity = capacity;
+    ring->watermark = watermark;
+
+    atomic_init(ATOMIC_FIELD(ring->head), 0u);
+    atomic_init(ATOMIC_FIELD(ring->tail), 0u);
+    atomic_init(ATOMIC_FIELD(ring->overrun_count), 0u);
+    atomic_init(ATOMIC_FIELD(ring->underrun_count), 0u);
+
+    return 0;
+}
+
+/**
+ * @see ptttl_ring_buffer.h
+ */
+uint32_t ptttl_ring_buffer_write(ptttl_ring_buffer_t *ring, const int16_t *samples,
+                                 uint32_t num_samples)
+{
+    uint32_t head = atomic_load_explicit(ATOMIC_FIELD(ring->head), memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(ATOMIC_FIELD(ring->tail), memory_order_acquire);
+    uint32_t space = ring->capacity - (head - tail);
+
+    if (num_samples > space)
+    {
+        atomic_fetch_add_explicit(ATOMIC_FIELD(ring->overrun_count), 1u, memory_order_relaxed);
+        num_samples = space;
+    }
+
+    _copy_samples(ring, head, (int16_t *) samples, num_samples, 1u);
+    atomic_store_explicit(ATOMIC_FIELD(ring->head), head + num_samples, memory_order_release);
+
+    return num_samples;
+}
+
+/**
+ * @see ptttl_ring_buffer.h
+ */
+int ptttl_ring_buffer_render(ptttl_ring_buffer_t *ring, ptttl_sample_generator_t *generator)
+{
+    if ((NULL == ring) || (NULL == generator))
+    {
+        return -1;
+    }
+
+    // Ring buffer only holds signed 16-bit mono samples
+    if ((PTTTL_SAMPLE_FORMAT_S16 != generator->config.sample_format) ||
+        (1u != generator->config.output_channels))
+    {
+        return -1;
+    }
+
+    uint32_t head = atomic_load_explicit(ATOMIC_FIELD(ring->head), memory_order_relaxed);
+
+    while (1)
+    {
+        uint32_t tail = atomic_load_explicit(ATOMIC_FIELD(ring->tail), memory_order_acquire);
+        uint32_t fill = head - tail;
+        if (fill >= ring->watermark)
+        {
+            return 0;
+        }
+
+        // Generate straight into the contiguous free region after the write index
+        uint32_t start = head & (ring->capacity - 1u);
+        uint32_t num_samples = ring->watermark - fill;
+        if (num_samples > (ring->capacity - start))
+        {
+            num_samples = ring->capacity - start;
+        }
+
+        int ret = ptttl_sample_generator_generate(generator, &num_samples, &ring->buffer[start]);
+        if (ret < 0)
+        {
+            return ret;
+        }
+
+        head += num_samples;
+        atomic_store_explicit(ATOMIC_FIELD(ring->head), head, memory_order_release);
+
+        if (1 == ret)
+        {
+            return 1;
+        }
+    }
+}
+
+/**
+ * @see ptttl_ring_buffer.h
+ */
+uint32_t ptttl_ring_buffer_read(ptttl_ring_buffer_t *ring, int16_t *samples, uint32_t num_samples)
+{
+    uint32_t tail = atomic_load_explicit(ATOMIC_FIELD(ring->tail), memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(ATOMIC_FIELD(ring->head), memory_order_acquire);
+    uint32_t available = head - tail;
+    uint32_t num_read = num_samples;
+
+    if (num_read > available)
+    {
+        // Not enough samples, play what we have and fill the rest with silence
+        atomic_fetch_add_explicit(ATOMIC_FIELD(ring->underrun_count), 1u, memory_order_relaxed);
+        num_read = available;
+        memset(&samples[num_read], 0, (num_samples - num_read) * sizeof(int16_t));
+    }
+
+    _copy_samples(ring, tail, samples, num_read, 0u);
+    atomic_store_explicit(ATOMIC_FIELD(ring->tail), tail + num_read, memory_order_release);
+
+    return num_read;
+}
+
+/**
+ * @see ptttl_ring_buffer.h
+ */
+uint32_t ptttl_ring_buffer_fill_level(ptttl_ring_buffer_t *ring)
+{
+    uint32_t tail = atomic_load_explicit(ATOMIC_FIELD(ring->tail), memory_order_acquire);
+    uint32_t head = atomic_load_explicit(ATOMIC_FIELD(ring->head), memory_order_acquire);
+    return head - tail;
+}
+
+/**
+ * @see ptttl_ring_buffer.h
+ */
+uint32_t ptttl_ring_buffer_underruns(ptttl_ring_buffer_t *ring)
+{
+    return atomic_load_explicit(ATOMIC_FIELD(ring->underrun_count), memory_order_relaxed);
+}
+
+/**
+ * @see ptttl_ring_buffer.h
+ */
+uint32_t ptttl_ring_buffer_overruns(ptttl_ring_buffer_t *ring)
+{
+    return atomic_load_explicit(ATOMIC_FIELD(ring->overrun_count), memory_order_relaxed);
+}
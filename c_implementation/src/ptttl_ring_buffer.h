@@ -0,0 +1,169 @@
+/* ptttl_ring_buffer.h
+ *
+ * Lock-free single-producer/single-consumer ring buffer of signed 16-bit audio samples,
+ * for real-time playback of the output of ptttl_sample_generator.c. A producer thread
+ * renders samples ahead of time into the ring, and a real-time consumer (e.g. an audio
+ * callback) reads samples out of the ring without ever blocking.
+ *
+ * Requires ptttl_parser.c and ptttl_sample_generator.c
+ *
+ * Requires stdint.h, stdatomic.h (C11) and memset()/memcpy() from string.h
+ *
+ * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
+ *
+ * Erik Nyquist 2025
+ */
+
+#ifndef PTTTL_RING_BUFFER_H
+#define PTTTL_RING_BUFFER_H
+
+
+#include <stdint.h>
+#include "ptttl_sample_generator.h"
+
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+
+/**
+ * Size of a cache line in bytes on the target platform. The producer-owned and
+ * consumer-owned fields of ptttl_ring_buffer_t are placed on separate cache lines
+ * of this size, so that the producer and consumer do not contend for the same line.
+ */
+#ifndef PTTTL_CACHE_LINE_SIZE
+#define PTTTL_CACHE_LINE_SIZE (64u)
+#endif // PTTTL_CACHE_LINE_SIZE
+
+
+/**
+ * Represents a single-producer/single-consumer ring buffer of audio samples.
+ *
+ * Exactly one thread may call the producer functions (#ptttl_ring_buffer_write and
+ * #ptttl_ring_buffer_render), and exactly one thread may call the consumer function
+ * (#ptttl_ring_buffer_read). All other functions may be called from any thread.
+ *
+ * The indices and counters are shared between threads, and are only ever accessed
+ * atomically by the functions in ptttl_ring_buffer.c; they are declared as plain
+ * integers so that this header can be used from C++, and must not be accessed directly.
+ * Padding keeps the producer-owned and consumer-owned fields at least one cache line apart.
+ */
+typedef struct
+{
+    uint32_t head;                       ///< Total no. of samples written, owned by the producer
+    uint32_t overrun_count;              ///< No. of writes that did not fit in the ring
+    uint8_t producer_pad[PTTTL_CACHE_LINE_SIZE - (2u * sizeof(uint32_t))];
+
+    uint32_t tail;                       ///< Total no. of samples read, owned by the consumer
+    uint32_t underrun_count;             ///< No. of reads that could not be fully satisfied
+    uint8_t consumer_pad[PTTTL_CACHE_LINE_SIZE - (2u * sizeof(uint32_t))];
+
+    int16_t *buffer;                     ///< Sample storage, provided by the caller
+    uint32_t capacity;                   ///< Size of sample storage, in samples (power of 2)
+    uint32_t watermark;                  ///< Fill level that #ptttl_ring_buffer_render renders up to
+} ptttl_ring_buffer_t;
+
+
+/**
+ * Initialize a ring buffer instance
+ *
+ * @param ring        Pointer to ring buffer instance to initialize
+ * @param buffer      Pointer to storage for samples. Must remain valid for as long
+ *                    as the ring buffer instance is in use.
+ * @param capacity    Number of samples that can be stored in 'buffer'. Must be a
+ *                    power of 2.
+ * @param watermark   Fill level, in samples, that #ptttl_ring_buffer_render will render
+ *                    ahead up to. This is how far ahead of the consumer the producer
+ *                    stays, so it should be large enough to cover the worst-case delay
+ *                    between calls to #ptttl_ring_buffer_render. Must not be larger than
+ *                    'capacity'.
+ *
+ * @return 0 if successful, -1 if an invalid parameter was provided
+ */
+int ptttl_ring_buffer_init(ptttl_ring_buffer_t *ring, int16_t *buffer, uint32_t capacity,
+                           uint32_t watermark);
+
+/**
+ * Write samples into the ring buffer (producer only). If there is not enough space
+ * for all samples, as many samples as will fit are written, the remaining samples
+ * are dropped, and the overrun counter is incremented.
+ *
+ * @param ring          Pointer to initialized ring buffer instance
+ * @param samples       Pointer to samples to write
+ * @param num_samples   Number of samples to write
+ *
+ * @return Number of samples actually written
+ */
+uint32_t ptttl_ring_buffer_write(ptttl_ring_buffer_t *ring, const int16_t *samples,
+                                 uint32_t num_samples);
+
+/**
+ * Generate samples directly into the ring buffer (producer only), until the fill
+ * level reaches the watermark provided to #ptttl_ring_buffer_init, or until the
+ * generator has no more samples. Samples are generated directly into the ring buffer
+ * storage, with no intermediate copy.
+ *
+ * @param ring        Pointer to initialized ring buffer instance
+ * @param generator   Pointer to initialized generator object. Must be configured to
+ *                    generate signed 16-bit samples (#PTTTL_SAMPLE_FORMAT_S16), with
+ *                    a single output channel.
+ *
+ * @return 0 if successful, 1 if all samples have been generated, and -1 if an error
+ *         occurred (including if the generator is not configured for signed 16-bit
+ *         mono samples). Call #ptttl_sample_generator_error for a description of generator
+ *         errors.
+ */
+int ptttl_ring_buffer_render(ptttl_ring_buffer_t *ring, ptttl_sample_generator_t *generator);
+
+/**
+ * Read samples out of the ring buffer (consumer only). Never blocks. If fewer samples
+ * are available than requested, the available samples are read, the remainder of the
+ * output is filled with silence, and the underrun counter is incremented.
+ *
+ * The consumer is not tied to any clock; it is expected to be called at whatever
+ * rate the audio output (or a simulated clock, for testing) consumes samples.
+ *
+ * @param ring          Pointer to initialized ring buffer instance
+ * @param samples       Pointer to location to store samples. The caller is expected
+ *                      to provide at least (sizeof(int16_t) * num_samples) bytes.
+ * @param num_samples   Number of samples to read
+ *
+ * @return Number of samples that were read from the ring (not including silence
+ *         inserted due to an underrun)
+ */
+uint32_t ptttl_ring_buffer_read(ptttl_ring_buffer_t *ring, int16_t *samples, uint32_t num_samples);
+
+/**
+ * Get the number of samples currently stored in the ring buffer
+ *
+ * @param ring   Pointer to initialized ring buffer instance
+ *
+ * @return Number of samples stored
+ */
+uint32_t ptttl_ring_buffer_fill_level(ptttl_ring_buffer_t *ring);
+
+/**
+ * Get the number of times #ptttl_ring_buffer_read could not be fully satisfied
+ *
+ * @param ring   Pointer to initialized ring buffer instance
+ *
+ * @return Underrun count
+ */
+uint32_t ptttl_ring_buffer_underruns(ptttl_ring_buffer_t *ring);
+
+/**
+ * Get the number of times #ptttl_ring_buffer_write had to drop samples
+ *
+ * @param ring   Pointer to initialized ring buffer instance
+ *
+ * @return Overrun count
+ */
+uint32_t ptttl_ring_buffer_overruns(ptttl_ring_buffer_t *ring);
+
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // PTTTL_RING_BUFFER_H
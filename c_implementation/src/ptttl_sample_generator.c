@@ -1,11 +1,12 @@
 /* ptttl_sample_generator.c
  *
- * Converts the output of ptttl_parse_next() into a stream of signed 16-bit audio samples
- * suitable for a WAV file. Samples can be obtained one at a time, at your leisure.
+ * Converts the output of ptttl_parse_next() into a stream of audio samples suitable for
+ * a WAV file (signed 16-bit by default, see ptttl_sample_format_e for other formats).
+ * Samples can be obtained one at a time, at your leisure.
  *
  * Requires ptttl_parser.c
  *
- * Requires stdint.h and memset() from string.h
+ * Requires stdint.h, stddef.h, and memset()/memcpy() from string.h
  *
  * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
  *
@@ -18,8 +19,42 @@
 #include "ptttl_common.h"
 
 
+// Max positive value of a signed 8-bit sample
+#define MAX_SAMPLE_VALUE_S8   (0x7F)
+
 // Max positive value of a signed 16-bit sample
-#define MAX_SAMPLE_VALUE   (0x7FFF)
+#define MAX_SAMPLE_VALUE_S16  (0x7FFF)
+
+// Max positive value of a signed 24-bit sample
+#define MAX_SAMPLE_VALUE_S24  (0x7FFFFF)
+
+// Value of an unsigned 8-bit sample representing silence
+#define ZERO_SAMPLE_VALUE_U8  (0x80)
+
+/* Max. number of consecutive samples generated for each voice at once. When voices
+ * are rendered in SIMD lanes, longer runs spread the cost of loading and storing the
+ * voice state of a block over more samples */
+#if PTTTL_VOICE_LANES > 0u
+#define VOICE_RUN_FRAMES (32u)
+#else
+#define VOICE_RUN_FRAMES (1u)
+#endif // PTTTL_VOICE_LANES > 0u
+
+// Min. number of sounding voices in a block of PTTTL_VOICE_LANES voices to render it in SIMD lanes
+#if PTTTL_VOICE_LANES > 0u
+#define LANE_MIN_SOUNDING_VOICES (PTTTL_VOICE_LANES / 2u)
+#else
+#define LANE_MIN_SOUNDING_VOICES (UINT32_MAX)
+#endif // PTTTL_VOICE_LANES > 0u
+
+
+#if (PTTTL_VOICE_STATE_ALIGN < 8u) || (0u != (PTTTL_VOICE_STATE_ALIGN & (PTTTL_VOICE_STATE_ALIGN - 1u)))
+#error "PTTTL_VOICE_STATE_ALIGN must be a power of 2, and at least 8"
+#endif
+
+#if (PTTTL_VOICE_LANES != 0u) && (PTTTL_VOICE_LANES != 4u) && (PTTTL_VOICE_LANES != 8u) && (PTTTL_VOICE_LANES != 16u)
+#error "PTTTL_VOICE_LANES must be 0, 4, 8 or 16"
+#endif
 
 
 // Store an error message for reporting by ptttl_sample_generator_error()
@@ -57,10 +92,14 @@ static unsigned int _raise_powerof2(unsigned int exp)
  * Fast sine approximation copied from:
  * https://github.com/skeeto/scratch/blob/master/misc/rtttl.c
  * x is in turns (0..1), not radians (0..2*pi)
+ *
+ * The first line is written as |x| + 0.5 (the same result as 0.5 - x for negative x)
+ * instead of a conditional subtraction, so that compilers can vectorize loops that call
+ * this function without branches.
  */
 static float fast_sinf(float x)
 {
-    x  = x < 0 ? 0.5f - x : x;
+    x  = (x < 0 ? -x : x) + (x < 0 ? 0.5f : 0.0f);
     x -= 0.500f + (float)(int)x;
     x *= 16.00f * ((x < 0 ? -x : x) - 0.50f);
     x += 0.225f * ((x < 0 ? -x : x) - 1.00f) * x;
@@ -69,48 +108,28 @@ static float fast_sinf(float x)
 
 
 /**
- * Generate a single point on a sine wave, between 0.0-1.0, for a given sample rate and frequency
+ * Get the reference pitch to tune to for a sample generator configuration.
  *
- * @param sample_rate  Sampling rate
- * @param freq         Frequency of sine wave
- * @param sine_index   Index of sample within this note (0 is the first sample of the note)
+ * @param config  Pointer to sample generator configuration
  *
- * @return Sine wave sample
+ * @return Pitch of A4 in Hz, 440.0 if the configuration leaves it at 0.0
  */
-static float _generate_sine_point(unsigned int sample_rate, float freq, unsigned int sine_index)
+static float _reference_pitch(const ptttl_sample_generator_config_t *config)
 {
-    float sine_state = freq * (((float) sine_index) / (float) sample_rate);
-    return fast_sinf(sine_state);
+    return (0.0f == config->reference_pitch_hz) ? 440.0f : config->reference_pitch_hz;
 }
 
 
-/**
- * Generate a single sine wave sample between 0-65535 for a given sample rate and frequency
- *
- * @param sample_rate  Sampling rate
- * @param freq         Frequency of sine wave
- * @param sine_index   Index of sample within this note (0 is the first sample of the note)
- *
- * @return Sine wave sample
- */
-static int32_t _generate_sine_sample(unsigned int sample_rate, float freq, unsigned int sine_index)
-{
-    // Calculate sample value between 0.0 - 1.0
-    float sample_norm = _generate_sine_point(sample_rate, freq, sine_index);
-
-    // Convert to 0x0-0x7fff range
-    return (int32_t) (sample_norm * (float) MAX_SAMPLE_VALUE);
-}
-
 /**
  * Convert a piano key note number (1 through 88) to the corresponding pitch
  * in Hz.
  *
- * @param note_number Piano key note number from 1 through 88, where 1 is the lowest note
- *                    and 88 is the highest note.
- * @param pitch_hz    Pointer to location to store corresponding pitch in Hz
+ * @param note_number         Piano key note number from 1 through 88, where 1 is the
+ *                            lowest note and 88 is the highest note.
+ * @param reference_pitch_hz  Pitch of A4 in Hz
+ * @param pitch_hz            Pointer to location to store corresponding pitch in Hz
  */
-static void _note_number_to_pitch(uint32_t note_number, float *pitch_hz)
+static void _note_number_to_pitch(uint32_t note_number, float reference_pitch_hz, float *pitch_hz)
 {
     // Maps note_pitch_e enum values to the corresponding pitch in Hz
     static const float note_pitches[NOTE_PITCH_COUNT] =
@@ -154,36 +173,68 @@ static void _note_number_to_pitch(uint32_t note_number, float *pitch_hz)
         result = result * (float) _raise_powerof2((unsigned int) (octave - 4));
     }
 
-    *pitch_hz = result;
+    // Pitches above are for A4 = 440Hz, scale them to the requested reference pitch
+    *pitch_hz = result * (reference_pitch_hz / 440.0f);
 }
 
 
 /**
- * Load a single PTTTL note from a specific channel into a note_stream_t object
+ * Calculate the pitch for every note number up front, so that loading a note only
+ * needs to look it up
  *
- * @param generator    Pointer to initialized sample generator
+ * @param config        Pointer to valid sample generator configuration data
+ * @param note_pitches  Pointer to table of #PTTTL_NOTE_PITCH_TABLE_SIZE pitches to populate
+ */
+static void _init_pitch_table(const ptttl_sample_generator_config_t *config, float *note_pitches)
+{
+    // Note number 0 is a rest
+    note_pitches[0] = 0.0f;
+
+    for (uint32_t note_number = 1u; note_number < PTTTL_NOTE_PITCH_TABLE_SIZE; note_number++)
+    {
+        _note_number_to_pitch(note_number, _reference_pitch(config), &note_pitches[note_number]);
+    }
+}
+
+
+/**
+ * Calculate the length of a single PTTTL note in samples
+ *
+ * @param sample_rate  Sampling rate
  * @param note         Pointer to parsed note object
- * @param note_stream  Pointer to note stream object to populate
+ *
+ * @return Note length in samples
  */
-static void _load_note_stream(ptttl_sample_generator_t *generator, ptttl_output_note_t *note,
-                              ptttl_note_stream_t *note_stream)
+static unsigned int _note_num_samples(unsigned int sample_rate, ptttl_output_note_t *note)
 {
-    note_stream->sine_index = 0u;
-    note_stream->start_sample = generator->current_sample;
+    uint32_t time_ms = PTTTL_NOTE_DURATION(note);
+    float num_samples = ((float) time_ms) * (((float) sample_rate) / 1000.0f);
+    return (unsigned int) num_samples;
+}
 
-    note_stream->phasor_state = 0.0f;
 
+/**
+ * Compile a single parsed note into an event holding everything needed to start playing
+ * it, except for the sample it starts on
+ *
+ * @param config        Pointer to valid sample generator configuration data
+ * @param note_pitches  Pointer to note pitch table (see _init_pitch_table)
+ * @param note          Pointer to parsed note object
+ * @param channel_idx   Index of channel that the note was parsed from
+ * @param event         Pointer to location to store compiled event
+ */
+static void _compile_note(const ptttl_sample_generator_config_t *config, const float *note_pitches,
+                          ptttl_output_note_t *note, uint32_t channel_idx, ptttl_timeline_event_t *event)
+{
     // Calculate note time in samples
-    uint32_t time_ms = PTTTL_NOTE_DURATION(note);
-    float num_samples = ((float) time_ms) * (((float) generator->config.sample_rate) / 1000.0f);
-    note_stream->num_samples = (unsigned int) num_samples;
+    unsigned int num_samples = _note_num_samples(config->sample_rate, note);
 
     // Handle case where attack + delay is longer than note length
-    unsigned int attack = generator->config.attack_samples;
-    unsigned int decay = generator->config.decay_samples;
-    if ((attack + decay) > note_stream->num_samples)
+    unsigned int attack = config->attack_samples;
+    unsigned int decay = config->decay_samples;
+    if ((attack + decay) > num_samples)
     {
-        unsigned int diff = (attack + decay) - note_stream->num_samples;
+        unsigned int diff = (attack + decay) - num_samples;
         if (attack > decay)
         {
             attack = (attack > diff) ? attack - diff : 0u;
@@ -194,228 +245,2572 @@ static void _load_note_stream(ptttl_sample_generator_t *generator, ptttl_output_
         }
     }
 
-    note_stream->attack = attack;
-    note_stream->decay = decay;
-    note_stream->vibrato_frequency = PTTTL_NOTE_VIBRATO_FREQ(note);
-    note_stream->vibrato_variance = PTTTL_NOTE_VIBRATO_VAR(note);
+    event->channel = channel_idx;
+    event->note_settings = note->note_settings;
+    event->vibrato_settings = note->vibrato_settings;
+    event->num_samples = num_samples;
+    event->attack = attack;
+    event->decay = decay;
+    event->pitch_hz = note_pitches[PTTTL_NOTE_VALUE(note)];
+}
+
 
-    // Calculate note pitch from piano key number
-    note_stream->note_number = PTTTL_NOTE_VALUE(note);
+/**
+ * Advance the oscillator phase of a voice with vibrato by one sample. Vibrato varies
+ * the pitch of the note with a second, slower sine wave, so the phase is accumulated
+ * one sample at a time.
+ *
+ * @param voices         Pointer to voice state of sample generator
+ * @param channel_idx    Channel index of voice
+ * @param sample_rate    Sampling rate
+ * @param sine_index     Index of sample within this note (0 is the first sample generated for the note)
+ */
+static void _advance_vibrato_phasor(ptttl_voice_state_t *voices, uint32_t channel_idx, float sample_rate,
+                                    uint32_t sine_index)
+{
+    float vsine = fast_sinf(voices->vibrato_freq[channel_idx] * (((float) sine_index) / sample_rate));
+    float pitch_change_hz = voices->vibrato_var[channel_idx] * vsine;
+    float note_pitch_hz = voices->pitch_hz[channel_idx] + pitch_change_hz;
 
-    if (0u != note_stream->note_number)
+    float phasor = voices->phasor[channel_idx] + (note_pitch_hz / sample_rate);
+    if (phasor >= 1.0f)
     {
-        _note_number_to_pitch(note_stream->note_number, &note_stream->pitch_hz);
+        phasor -= 1.0f;
     }
+
+    voices->phasor[channel_idx] = phasor;
 }
 
+
 /**
- * @see ptttl_sample_generator.h
+ * Calculate the sample value for the current sample of a sounding (non-rest) voice,
+ * and advance the voice's oscillator and envelope state. Does not check for the end
+ * of the note.
+ *
+ * @param voices         Pointer to voice state of sample generator
+ * @param channel_idx    Channel index of voice to generate a sample for
+ * @param sample_rate    Sampling rate
+ * @param amplitude      Amplitude of generated samples, between 0.0-1.0
+ *
+ * @return Sample value between -1.0 and 1.0, scaled by the configured amplitude
  */
-ptttl_parser_error_t ptttl_sample_generator_error(void)
+static float _voice_sample_value(ptttl_voice_state_t *voices, uint32_t channel_idx, float sample_rate,
+                                 float amplitude)
 {
-    return _error;
+    float raw_sample = 0.0f;
+    uint32_t sine_index = voices->sine_index[channel_idx];
+
+    if ((0.0f != voices->vibrato_freq[channel_idx]) || (0.0f != voices->vibrato_var[channel_idx]))
+    {
+        raw_sample = fast_sinf(voices->phasor[channel_idx]);
+        _advance_vibrato_phasor(voices, channel_idx, sample_rate, sine_index);
+    }
+    else
+    {
+        raw_sample = fast_sinf(voices->pitch_hz[channel_idx] * (((float) sine_index) / sample_rate));
+    }
+
+    voices->sine_index[channel_idx] = sine_index + 1u;
+
+    // Handle attack & decay
+    uint32_t samples_elapsed = voices->elapsed[channel_idx];
+    uint32_t samples_remaining = voices->length[channel_idx] - samples_elapsed;
+    voices->elapsed[channel_idx] = samples_elapsed + 1u;
+
+    // Modify channel sample amplitude based on attack/decay settings
+    if (samples_elapsed < voices->attack[channel_idx])
+    {
+        raw_sample *= ((float) samples_elapsed) / ((float) voices->attack[channel_idx]);
+    }
+    else if (samples_remaining < voices->decay[channel_idx])
+    {
+        raw_sample *= ((float) samples_remaining) / ((float) voices->decay[channel_idx]);
+    }
+
+    // Set final desired amplitude for channel sample
+    return raw_sample * amplitude;
 }
 
+
 /**
- * @see ptttl_sample_generator.h
+ * Empty a note cache if its samples were generated with a different configuration,
+ * and reset its pin counts, so that it can be used by a new sample generator
+ *
+ * @param generator    Pointer to sample generator with a valid configuration
  */
-int ptttl_sample_generator_create(ptttl_parser_t *parser, ptttl_sample_generator_t *generator,
-                                  ptttl_sample_generator_config_t *config)
+static void _attach_note_cache(ptttl_sample_generator_t *generator)
 {
-    if (NULL == parser)
+    ptttl_note_cache_t *cache = generator->config.note_cache;
+    ptttl_sample_generator_config_t *config = &generator->config;
+
+    uint8_t config_changed = (cache->sample_rate != config->sample_rate) ||
+                             (cache->attack_samples != config->attack_samples) ||
+                             (cache->decay_samples != config->decay_samples) ||
+                             (cache->amplitude != config->amplitude) ||
+                             (cache->reference_pitch_hz != config->reference_pitch_hz);
+
+    for (uint32_t slot = 0u; slot < cache->slot_count; slot++)
     {
-        return -1;
+        // Slots may still be pinned if the previous sample generator did not finish
+        cache->entries[slot].pin_count = 0u;
+
+        if (config_changed)
+        {
+            cache->entries[slot].sample_count = 0u;
+            cache->entries[slot].last_used = 0u;
+        }
     }
 
-    if ((NULL == generator) || (NULL == config))
+    cache->sample_rate = config->sample_rate;
+    cache->attack_samples = config->attack_samples;
+    cache->decay_samples = config->decay_samples;
+    cache->amplitude = config->amplitude;
+    cache->reference_pitch_hz = config->reference_pitch_hz;
+}
+
+
+/**
+ * Start playing a newly loaded note from the note cache. If the note is not in the
+ * cache, then all of its samples are generated into the least recently used slot that
+ * is not currently being played from, and it is played from there. Notes that are too
+ * long for a slot, or that are loaded while every slot is being played from, are
+ * generated as normal.
+ *
+ * @param generator    Pointer to initialized sample generator with a note cache
+ * @param event        Pointer to compiled event for the note
+ * @param channel_idx  Channel index of channel the note has been loaded for
+ */
+static void _load_cached_note(ptttl_sample_generator_t *generator, const ptttl_timeline_event_t *event,
+                              uint32_t channel_idx)
+{
+    ptttl_note_cache_t *cache = generator->config.note_cache;
+    ptttl_note_stream_t *note_stream = &generator->note_streams[channel_idx];
+    uint32_t first_note = (0u == generator->voices.elapsed[channel_idx]) ? 1u : 0u;
+
+    /* Samples are generated for elapsed sample counts from 1 up to and including the
+     * note length (or from 0, for the first note on a channel), and at least 1 sample */
+    uint32_t sample_count = note_stream->num_samples + first_note;
+    if (0u == sample_count)
     {
-        ERROR(parser, "NULL pointer passed to function");
-        return -1;
+        sample_count = 1u;
     }
 
-    if (0u == parser->channel_count)
+    cache->use_counter += 1u;
+    if (0u == cache->use_counter)
     {
-        ERROR(parser, "PTTTL parser object has a channel count of 0");
-        return -1;
+        // Use counter has wrapped around, forget how recently each slot was used
+        for (uint32_t slot = 0u; slot < cache->slot_count; slot++)
+        {
+            cache->entries[slot].last_used = 0u;
+        }
+
+        cache->use_counter = 1u;
     }
 
-    if ((config->amplitude > 1.0f) || (config->amplitude < 0.0f))
+    uint8_t hit = 0u;
+    uint32_t cache_slot = cache->slot_count;
+    for (uint32_t slot = 0u; slot < cache->slot_count; slot++)
     {
-        ERROR(parser, "Sample generator amplitude must be between 0.0 - 1.0");
-        return -1;
-    }
+        ptttl_note_cache_entry_t *entry = &cache->entries[slot];
 
-    // Copy config data into generator object
-    generator->config = *config;
-    generator->parser = parser;
+        if ((0u < entry->sample_count) && (event->note_settings == entry->note_settings) &&
+            (event->vibrato_settings == entry->vibrato_settings) && (first_note == entry->first_note))
+        {
+            hit = 1u;
+            cache_slot = slot;
+            break;
+        }
 
-    generator->current_sample = 0u;
+        // Find the least recently used slot that is not being played from (empty slots first)
+        if ((0u == entry->pin_count) &&
+            ((cache->slot_count == cache_slot) || (entry->last_used < cache->entries[cache_slot].last_used)))
+        {
+            cache_slot = slot;
+        }
+    }
 
-    memset(generator->channel_finished, 0, sizeof(generator->channel_finished));
+    float *samples = &cache->samples[(size_t) cache_slot * cache->slot_samples];
+    ptttl_note_cache_entry_t *entry = &cache->entries[cache_slot];
 
-    // Populate note streams for initial note on all channels
-    for (uint32_t chan = 0u; chan < parser->channel_count; chan++)
+    if (hit)
     {
-        ptttl_output_note_t note;
-        int ret = ptttl_parse_next(generator->parser, chan, &note);
-        if (ret != 0)
+        cache->hits += 1u;
+    }
+    else
+    {
+        cache->misses += 1u;
+
+        if (sample_count > cache->slot_samples)
         {
-            _error = ptttl_parser_error(generator->parser);
-            return ret;
+            cache->oversized += 1u;
+            return;
+        }
+
+        if (cache->slot_count == cache_slot)
+        {
+            // Every slot is being played from
+            return;
+        }
+
+        /* Generate all samples for the note into the slot. This leaves the voice state
+         * at the end of the note, which is fine since it is not used while playing from
+         * the cache, and is reset when the next note is loaded */
+        for (uint32_t i = 0u; i < sample_count; i++)
+        {
+            samples[i] = _voice_sample_value(&generator->voices, channel_idx, (float) generator->config.sample_rate,
+                                              generator->config.amplitude);
         }
 
-        _load_note_stream(generator, &note, &generator->note_streams[chan]);
+        entry->note_settings = event->note_settings;
+        entry->vibrato_settings = event->vibrato_settings;
+        entry->first_note = first_note;
+        entry->sample_count = sample_count;
     }
 
-    return 0;
+    entry->pin_count += 1u;
+    entry->last_used = cache->use_counter;
+
+    note_stream->cached_samples = samples;
+    note_stream->cached_position = 0u;
+    note_stream->cache_slot = cache_slot;
 }
 
+
 /**
- * Generate the next sample for the given note stream on the given channel
+ * Stop playing the current note for a channel from the note cache, if it is being
+ * played from the cache, so that its slot can be replaced
  *
- * @param generator      Pointer to initialized sample generator
- * @param stream         Pointer to ptttl_note_stream_t instance to generate a sample for
- * @param channel_idx    Channel index of channel the generated sample is for
- * @param sample         Pointer to location to store generated sample
- *
- * @return 0 if there are more samples remaining for the provided note stream,
-             1 if no more samples, -1 if an error occurred
+ * @param generator    Pointer to initialized sample generator
+ * @param channel_idx  Channel index of channel whose note has ended
  */
-static int _generate_channel_sample(ptttl_sample_generator_t *generator, ptttl_note_stream_t *stream,
-                                    unsigned int channel_idx, float *sample)
+static void _release_cached_note(ptttl_sample_generator_t *generator, uint32_t channel_idx)
 {
-    int ret = 0;
+    ptttl_note_stream_t *note_stream = &generator->note_streams[channel_idx];
 
-    // Generate next sample value for this channel
-    if (0u == stream->note_number) // Note number 0 indicates pause/rest
+    if (NULL != note_stream->cached_samples)
     {
-        *sample = 0.0f;
+        generator->config.note_cache->entries[note_stream->cache_slot].pin_count -= 1u;
+        note_stream->cached_samples = NULL;
     }
-    else
+}
+
+
+/**
+ * Calculate the sample value for the current sample of a sounding (non-rest) channel,
+ * either by generating it, or by playing it from the note cache. Does not check for
+ * the end of the note.
+ *
+ * @param generator    Pointer to initialized sample generator
+ * @param channel_idx  Channel index of channel to generate a sample for
+ *
+ * @return Sample value between -1.0 and 1.0, scaled by the configured amplitude
+ */
+static float _channel_sample_value(ptttl_sample_generator_t *generator, uint32_t channel_idx)
+{
+    ptttl_note_stream_t *note_stream = &generator->note_streams[channel_idx];
+
+    if (NULL != note_stream->cached_samples)
     {
-        int32_t raw_sample = 0;
+        float sample = note_stream->cached_samples[note_stream->cached_position];
+        note_stream->cached_position += 1u;
+        return sample;
+    }
 
-        if ((0u != stream->vibrato_frequency) || (0u != stream->vibrato_variance))
-        {
-            float vsine = _generate_sine_point(generator->config.sample_rate, stream->vibrato_frequency,
-                                               stream->sine_index);
-            float pitch_change_hz = ((float) stream->vibrato_variance) * vsine;
-            float note_pitch_hz = stream->pitch_hz + pitch_change_hz;
+    return _voice_sample_value(&generator->voices, channel_idx, (float) generator->config.sample_rate,
+                               generator->config.amplitude);
+}
 
-            float vsample = fast_sinf(stream->phasor_state);
 
-            float phasor_inc = note_pitch_hz / generator->config.sample_rate;
-            stream->phasor_state += phasor_inc;
-            if (stream->phasor_state >= 1.0f)
-            {
-                stream->phasor_state -= 1.0f;
-            }
+/**
+ * Load a single compiled note into the note stream and voice state for its channel
+ *
+ * @param generator      Pointer to initialized sample generator
+ * @param event          Pointer to compiled event for the note
+ * @param first_elapsed  Elapsed sample count for the first sample generated for the note
+ */
+static void _load_note_stream(ptttl_sample_generator_t *generator, const ptttl_timeline_event_t *event,
+                              uint32_t first_elapsed)
+{
+    uint32_t channel_idx = event->channel;
+    ptttl_note_stream_t *note_stream = &generator->note_streams[channel_idx];
+    ptttl_voice_state_t *voices = &generator->voices;
+
+    note_stream->start_sample = generator->current_sample;
+    note_stream->num_samples = event->num_samples;
+    note_stream->vibrato_frequency = PTTTL_NOTE_VIBRATO_FREQ(event);
+    note_stream->vibrato_variance = PTTTL_NOTE_VIBRATO_VAR(event);
+
+    // Look up note pitch from piano key number
+    note_stream->note_number = PTTTL_NOTE_VALUE(event);
+    note_stream->pitch_hz = event->pitch_hz;
+
+    voices->phasor[channel_idx] = 0.0f;
+    voices->pitch_hz[channel_idx] = event->pitch_hz;
+    voices->vibrato_freq[channel_idx] = (float) note_stream->vibrato_frequency;
+    voices->vibrato_var[channel_idx] = (float) note_stream->vibrato_variance;
+    voices->sine_index[channel_idx] = 0u;
+    voices->elapsed[channel_idx] = first_elapsed;
+    voices->length[channel_idx] = event->num_samples;
+    voices->attack[channel_idx] = event->attack;
+    voices->decay[channel_idx] = event->decay;
+
+    if ((NULL != generator->config.note_cache) && (0u != note_stream->note_number))
+    {
+        _load_cached_note(generator, event, channel_idx);
+    }
+}
+
+/**
+ * Parse notes for a single channel into its prefetch queue, until the queue holds a
+ * given number of notes or the parser has no more notes for the channel
+ *
+ * @param generator    Pointer to initialized sample generator
+ * @param channel_idx  Channel index of channel to parse notes for
+ * @param min_count    Number of notes the queue should hold, no more than #PTTTL_NOTE_PREFETCH_COUNT
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+static int _prefetch_channel(ptttl_sample_generator_t *generator, uint32_t channel_idx, uint32_t min_count)
+{
+    ptttl_note_prefetch_queue_t *queue = &generator->prefetch_queues[channel_idx];
 
-            raw_sample = (int32_t) (vsample * (float) MAX_SAMPLE_VALUE);
+    while ((0u == queue->parser_finished) && (min_count > queue->count))
+    {
+        uint32_t tail = (queue->head + queue->count) % PTTTL_NOTE_PREFETCH_COUNT;
+        int ret = ptttl_parse_next(generator->parser, channel_idx, &queue->notes[tail]);
+        if (ret < 0)
+        {
+            _error = ptttl_parser_error(generator->parser);
+            return ret;
+        }
+        else if (ret == 1)
+        {
+            queue->parser_finished = 1u;
         }
         else
         {
-            raw_sample = _generate_sine_sample(generator->config.sample_rate, stream->pitch_hz, stream->sine_index);
+            queue->count += 1u;
         }
+    }
 
-        stream->sine_index += 1u;
+    return 0;
+}
 
-        // Handle attack & decay
-        unsigned int samples_elapsed = generator->current_sample - stream->start_sample;
-        unsigned int samples_remaining = stream->num_samples - samples_elapsed;
+/**
+ * Take the next note for a single channel, compiled into an event. Notes are taken from
+ * the timeline if the generator has one, and otherwise from the channel's prefetch queue.
+ * If the prefetch queue is empty, a single note is parsed directly; this only happens
+ * when notes are skipped without generating their samples, since
+ * ptttl_sample_generator_generate refills empty queues before the per-sample path.
+ *
+ * @param generator    Pointer to initialized sample generator
+ * @param channel_idx  Channel index of channel to take the next note for
+ * @param event        Pointer to location to store the compiled event for the next note
+ *
+ * @return 0 if a note was taken, 1 if there are no more notes for this channel,
+ *         and -1 if an error occurred
+ */
+static int _take_next_note(ptttl_sample_generator_t *generator, uint32_t channel_idx,
+                           ptttl_timeline_event_t *event)
+{
+    ptttl_note_prefetch_queue_t *queue = &generator->prefetch_queues[channel_idx];
+    const ptttl_timeline_t *timeline = generator->config.timeline;
 
-        // Modify channel sample amplitude based on attack/decay settings
-        if (samples_elapsed < stream->attack)
-        {
-            raw_sample *= ((float) samples_elapsed) / ((float) stream->attack);
-        }
-        else if (samples_remaining < stream->decay)
+    if (NULL != timeline)
+    {
+        if (timeline->channel_events[channel_idx + 1u] == queue->next_event)
         {
-            raw_sample *= ((float) samples_remaining) / ((float) stream->decay);
+            return 1;
         }
 
-        // Set final desired amplitude for channel sample
-        *sample = ((float) raw_sample) * generator->config.amplitude;
+        *event = timeline->events[queue->next_event];
+        queue->next_event += 1u;
+        return 0;
     }
 
-    // Check if last sample for this note stream
-    if ((generator->current_sample - stream->start_sample) >= stream->num_samples)
+    if (0u == queue->count)
     {
-        // Load the next note for this channel
-        ptttl_output_note_t note;
-        ret = ptttl_parse_next(generator->parser, channel_idx, &note);
-        if (ret == 0)
+        int ret = _prefetch_channel(generator, channel_idx, 1u);
+        if (ret < 0)
         {
-            _load_note_stream(generator, &note, &generator->note_streams[channel_idx]);
+            return ret;
         }
-        else if (ret < 0)
+
+        if (0u == queue->count)
         {
-            _error = ptttl_parser_error(generator->parser);
+            return 1;
         }
     }
 
-    return ret;
+    _compile_note(&generator->config, generator->note_pitches, &queue->notes[queue->head],
+                  channel_idx, event);
+    event->start_sample = generator->current_sample;
+    queue->head = (queue->head + 1u) % PTTTL_NOTE_PREFETCH_COUNT;
+    queue->count -= 1u;
+
+    return 0;
 }
 
 /**
- * @see ptttl_sample_generator.h
+ * Load the next note for a single channel into the corresponding note stream
+ *
+ * @param generator      Pointer to initialized sample generator
+ * @param channel_idx    Channel index of channel to load the next note for
+ * @param first_elapsed  Elapsed sample count for the first sample generated for the note;
+ *                       notes are loaded while generating the last sample of the previous
+ *                       note, so this is 1, except for the first note on each channel
+ *
+ * @return 0 if a note was loaded, 1 if there are no more notes for this channel,
+ *         and -1 if an error occurred
  */
-int ptttl_sample_generator_generate(ptttl_sample_generator_t *generator, uint32_t *num_samples,
-                                    int16_t *samples)
+static int _load_next_note(ptttl_sample_generator_t *generator, uint32_t channel_idx,
+                           uint32_t first_elapsed)
 {
-    if (NULL == generator)
-    {
-        return -1;
-    }
+    // Previous note (if any) has ended
+    _release_cached_note(generator, channel_idx);
 
-    if ((NULL == num_samples) || (NULL == samples))
+    ptttl_timeline_event_t event;
+    int ret = _take_next_note(generator, channel_idx, &event);
+    if (ret != 0)
     {
-        ERROR(generator->parser, "NULL pointer passed to function");
-        return -1;
+        return ret;
     }
 
-    uint32_t samples_to_generate = *num_samples;
-    *num_samples = 0u;
-
-    for (unsigned int samplenum = 0u; samplenum < samples_to_generate; samplenum++)
-    {
-        float summed_sample = 0.0f;
-        unsigned int num_channels_provided = 0u;
-
-        // Sum the current state of all channels to generate the next sample
-        for (unsigned int chan = 0u; chan < generator->parser->channel_count; chan++)
-        {
-            if (1u == generator->channel_finished[chan])
-            {
-                // No more samples to generate for this channel
-                continue;
-            }
-
-            num_channels_provided += 1u;
-            ptttl_note_stream_t *stream = &generator->note_streams[chan];
+    _load_note_stream(generator, &event, first_elapsed);
 
-            float chan_sample = 0.0f;
-            int ret = _generate_channel_sample(generator, stream, chan, &chan_sample);
-            if (ret < 0)
-            {
-                return ret;
-            }
+    return 0;
+}
 
-            generator->channel_finished[chan] = ret;
+/**
+ * Rebuild the lists of active and sounding channels. Only needs to be called after a
+ * note has ended on at least one channel, since the lists cannot change otherwise.
+ *
+ * @param generator    Pointer to initialized sample generator
+ */
+static void _update_voice_lists(ptttl_sample_generator_t *generator)
+{
+    uint32_t active_count = 0u;
+    uint32_t sounding_count = 0u;
 
-            summed_sample += chan_sample;
+    for (uint32_t i = 0u; i < generator->active_count; i++)
+    {
+        uint32_t chan = generator->active_channels[i];
+        if (1u == generator->channel_finished[chan])
+        {
+            continue;
         }
 
-        if (num_channels_provided == 0u)
+        generator->active_channels[active_count] = chan;
+        active_count += 1u;
+
+        if (0u != generator->note_streams[chan].note_number)
         {
-            // Finished-- no samples left on any channel
-            return 1;
+            generator->sounding_channels[sounding_count] = chan;
+            sounding_count += 1u;
         }
+    }
 
-        generator->current_sample += 1u;
-        samples[samplenum] = (int16_t) (summed_sample / (float) generator->parser->channel_count);
-        *num_samples += 1u;
+    generator->active_count = active_count;
+    generator->sounding_count = sounding_count;
+}
+
+/**
+ * Add a 32-bit value to a 64-bit FNV-1a hash, one byte at a time
+ *
+ * @param hash   Hash value so far
+ * @param value  Value to add
+ *
+ * @return New hash value
+ */
+static uint64_t _fnv1a_add_u32(uint64_t hash, uint32_t value)
+{
+    for (unsigned int i = 0u; i < 4u; i++)
+    {
+        hash = (hash ^ ((value >> (i * 8u)) & 0xffu)) * FNV1A_64_PRIME;
+    }
+
+    return hash;
+}
+
+/**
+ * Record the sample on which the last note of a block ends on one channel, and clear
+ * the aligned flag of the block if it ends on a different sample on another channel
+ *
+ * @param entry        Pointer to block cache entry for the block
+ * @param end_sample   Sample on which the last note of the block ends on this channel
+ */
+static void _end_channel_block(ptttl_block_cache_entry_t *entry, uint64_t end_sample)
+{
+    // Channels are scanned in order, so the first channel to reach a block records its end
+    if (1u == entry->channels_seen)
+    {
+        entry->end_sample = end_sample;
+    }
+    else if (entry->end_sample != end_sample)
+    {
+        entry->aligned = 0u;
+    }
+}
+
+/**
+ * Parse all notes for a single channel, and record the samples on which the channel
+ * starts and ends each block, and the notes it has in each block, in the block cache
+ *
+ * @param generator    Pointer to sample generator with a block cache
+ * @param channel_idx  Index of channel to scan
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+static int _scan_channel_blocks(ptttl_sample_generator_t *generator, uint32_t channel_idx)
+{
+    ptttl_block_cache_t *cache = generator->config.block_cache;
+    ptttl_parser_t *parser = generator->parser;
+    ptttl_block_cache_entry_t *entry = NULL;
+    uint64_t end_sample = 0u;
+    uint8_t first_note = 1u;
+    ptttl_output_note_t note;
+    int ret = 0;
+
+    while (1)
+    {
+        uint32_t block = parser->channels[channel_idx].block;
+        ret = ptttl_parse_next(parser, channel_idx, &note);
+        if (ret != 0)
+        {
+            break;
+        }
+
+        if (block >= cache->block_count)
+        {
+            ERROR(parser, "Block cache was initialized for a different PTTTL source text");
+            return -1;
+        }
+
+        if (&cache->entries[block] != entry)
+        {
+            // First note of a new block on this channel
+            if (NULL != entry)
+            {
+                _end_channel_block(entry, end_sample);
+            }
+
+            entry = &cache->entries[block];
+            if (0u == entry->channels_seen)
+            {
+                entry->start_sample = end_sample;
+            }
+            else if (entry->start_sample != end_sample)
+            {
+                entry->aligned = 0u;
+            }
+
+            entry->channels_seen += 1u;
+        }
+
+        /* Track the sample on which each note ends the same way as _channel_last_sample;
+         * the first note on each channel ends on its length in samples, and each following
+         * note runs for at least one sample */
+        unsigned int num_samples = _note_num_samples(generator->config.sample_rate, &note);
+        if (1u == first_note)
+        {
+            end_sample = num_samples;
+            first_note = 0u;
+        }
+        else
+        {
+            end_sample += (0u == num_samples) ? 1u : num_samples;
+        }
+
+        entry->note_fingerprint = _fnv1a_add_u32(entry->note_fingerprint, channel_idx);
+        entry->note_fingerprint = _fnv1a_add_u32(entry->note_fingerprint, note.note_settings);
+        entry->note_fingerprint = _fnv1a_add_u32(entry->note_fingerprint, note.vibrato_settings);
+    }
+
+    if (ret < 0)
+    {
+        _error = ptttl_parser_error(parser);
+        return ret;
+    }
+
+    if (NULL != entry)
+    {
+        _end_channel_block(entry, end_sample);
+    }
+
+    return 0;
+}
+
+/**
+ * Scan all notes of all channels to find which blocks in the block cache start and end
+ * on the same sample on every channel, and find the blocks that can be copied from an
+ * identical earlier block. Room in the PCM storage of the block cache is given to the
+ * first occurrence of each repeated block, in order, for as long as there is room.
+ *
+ * @param generator    Pointer to sample generator with a block cache
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+static int _scan_blocks(ptttl_sample_generator_t *generator)
+{
+    ptttl_block_cache_t *cache = generator->config.block_cache;
+    ptttl_parser_t *parser = generator->parser;
+
+    for (uint32_t block = 0u; block < cache->block_count; block++)
+    {
+        ptttl_block_cache_entry_t *entry = &cache->entries[block];
+        entry->note_fingerprint = FNV1A_64_OFFSET;
+        entry->start_sample = 0u;
+        entry->end_sample = 0u;
+        entry->pcm_offset = SIZE_MAX;
+        entry->source = UINT32_MAX;
+        entry->channels_seen = 0u;
+        entry->stored = 0u;
+
+        // The first note on each channel runs for one extra sample, so never copy the first block
+        entry->aligned = (0u == block) ? 0u : 1u;
+    }
+
+    for (uint32_t chan = 0u; chan < parser->channel_count; chan++)
+    {
+        // Leave the parser positioned at the start of each channel, as for ptttl_compute_total_samples
+        ptttl_parser_input_stream_t saved_stream = parser->channels[chan];
+        int ret = _scan_channel_blocks(generator, chan);
+        parser->channels[chan] = saved_stream;
+        parser->active_stream = &parser->stream;
+
+        if (ret < 0)
+        {
+            return ret;
+        }
+    }
+
+    size_t frame_size = ptttl_sample_format_size(generator->config.sample_format) * generator->config.output_channels;
+    size_t pcm_used = 0u;
+
+    for (uint32_t block = 1u; block < cache->block_count; block++)
+    {
+        ptttl_block_cache_entry_t *entry = &cache->entries[block];
+        if (entry->channels_seen != parser->channel_count)
+        {
+            entry->aligned = 0u;
+        }
+
+        if (0u == entry->aligned)
+        {
+            continue;
+        }
+
+        uint64_t frames = entry->end_sample - entry->start_sample;
+
+        // Find the first occurrence of this block, if it is a repeat
+        for (uint32_t first = 1u; first < block; first++)
+        {
+            ptttl_block_cache_entry_t *first_entry = &cache->entries[first];
+            if ((0u == first_entry->aligned) || (cache->fingerprints[first] != cache->fingerprints[block]) ||
+                (first_entry->note_fingerprint != entry->note_fingerprint) ||
+                ((first_entry->end_sample - first_entry->start_sample) != frames))
+            {
+                continue;
+            }
+
+            if ((SIZE_MAX == first_entry->pcm_offset) && (((cache->pcm_size - pcm_used) / frame_size) >= frames))
+            {
+                first_entry->pcm_offset = pcm_used;
+                pcm_used += (size_t) frames * frame_size;
+            }
+
+            if (SIZE_MAX != first_entry->pcm_offset)
+            {
+                entry->source = first;
+            }
+
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Start copying or storing the samples for a block in the block cache, if the current
+ * sample is the first sample of a block that starts on the same sample on every channel
+ *
+ * @param generator    Pointer to initialized sample generator with a block cache
+ * @param allow_copy   1 if the block may be copied from the cache, 0 if it must be
+ *                     generated (skipping the notes of a copied block may need the parser)
+ */
+static void _start_cached_block(ptttl_sample_generator_t *generator, uint8_t allow_copy)
+{
+    ptttl_block_cache_t *cache = generator->config.block_cache;
+    ptttl_block_cache_entry_t *entry = NULL;
+
+    /* Blocks start on the sample after the last notes of the previous block end, since
+     * notes are loaded while generating the last sample of the previous note. Skip blocks
+     * that cannot be copied, and blocks that have already started. */
+    while (generator->next_block < cache->block_count)
+    {
+        entry = &cache->entries[generator->next_block];
+        if ((1u == entry->aligned) && ((entry->start_sample + 1u) >= generator->current_sample))
+        {
+            break;
+        }
+
+        generator->next_block += 1u;
+    }
+
+    if ((generator->next_block == cache->block_count) || ((entry->start_sample + 1u) != generator->current_sample))
+    {
+        return;
+    }
+
+    uint32_t block = generator->next_block;
+    uint64_t frames = entry->end_sample - entry->start_sample;
+    generator->next_block += 1u;
+
+    if ((1u == allow_copy) && (UINT32_MAX != entry->source) && (1u == cache->entries[entry->source].stored))
+    {
+        generator->cache_pcm = &cache->pcm[cache->entries[entry->source].pcm_offset];
+        generator->copy_remaining = frames;
+        generator->cache_block = block;
+    }
+    else if (SIZE_MAX != entry->pcm_offset)
+    {
+        generator->cache_pcm = &cache->pcm[entry->pcm_offset];
+        generator->store_remaining = frames;
+        generator->cache_block = block;
+    }
+}
+
+/**
+ * Store newly generated sample frames in the block cache, if the first occurrence of a
+ * repeated block is being generated
+ *
+ * @param generator      Pointer to initialized sample generator
+ * @param samples        Pointer to output sample buffer
+ * @param first_frame    Index of first newly generated frame within output sample buffer
+ * @param frame_count    Number of newly generated frames
+ */
+static void _store_block_samples(ptttl_sample_generator_t *generator, const void *samples,
+                                 uint32_t first_frame, uint32_t frame_count)
+{
+    if (0u == generator->store_remaining)
+    {
+        return;
+    }
+
+    if ((uint64_t) frame_count > generator->store_remaining)
+    {
+        frame_count = (uint32_t) generator->store_remaining;
+    }
+
+    size_t frame_size = ptttl_sample_format_size(generator->config.sample_format) * generator->config.output_channels;
+    memcpy(generator->cache_pcm, &((const uint8_t *) samples)[first_frame * frame_size], frame_count * frame_size);
+    generator->cache_pcm += frame_count * frame_size;
+    generator->store_remaining -= frame_count;
+
+    if (0u == generator->store_remaining)
+    {
+        generator->config.block_cache->entries[generator->cache_block].stored = 1u;
+    }
+}
+
+/**
+ * Skip the notes of a block whose samples have been copied from the block cache, and
+ * load the first note of the next block on every channel, as if all samples of the
+ * block had been generated
+ *
+ * @param generator      Pointer to initialized sample generator
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+static int _skip_copied_block(ptttl_sample_generator_t *generator)
+{
+    uint64_t end_sample = generator->config.block_cache->entries[generator->cache_block].end_sample;
+
+    // Notes are loaded while generating the last sample of the previous note
+    generator->current_sample = end_sample;
+
+    // Every channel has notes in the block, so all channels are still active
+    for (uint32_t i = 0u; i < generator->active_count; i++)
+    {
+        uint32_t chan = generator->active_channels[i];
+        ptttl_note_stream_t *stream = &generator->note_streams[chan];
+
+        // The note loaded at the start of the block runs for at least one sample
+        uint64_t note_end = stream->start_sample + ((0u == stream->num_samples) ? 1u : stream->num_samples);
+        while (note_end < end_sample)
+        {
+            ptttl_timeline_event_t event;
+            int ret = _take_next_note(generator, chan, &event);
+            if (ret != 0)
+            {
+                return (ret < 0) ? ret : -1;
+            }
+
+            note_end += (0u == event.num_samples) ? 1u : event.num_samples;
+        }
+
+        int ret = _load_next_note(generator, chan, 1u);
+        if (ret < 0)
+        {
+            return ret;
+        }
+
+        generator->channel_finished[chan] = ret;
+    }
+
+    _update_voice_lists(generator);
+    generator->current_sample = end_sample + 1u;
+
+    return 0;
+}
+
+/**
+ * Find the last note of a timeline channel that is loaded before a given sample, i.e. the
+ * note that is playing on that sample (or the last note, if the channel has finished)
+ *
+ * @param timeline      Pointer to compiled timeline
+ * @param channel_idx   Index of channel to search
+ * @param sample_index  Sample index to search for
+ *
+ * @return Index of the event for the note
+ */
+static uint32_t _find_timeline_note(const ptttl_timeline_t *timeline, uint32_t channel_idx,
+                                    uint64_t sample_index)
+{
+    uint32_t low = timeline->channel_events[channel_idx];
+    uint32_t high = timeline->channel_events[channel_idx + 1u];
+    uint32_t first = low;
+
+    // Find the first event loaded on or after the sample
+    while (low < high)
+    {
+        uint32_t mid = low + ((high - low) / 2u);
+        if (timeline->events[mid].start_sample < sample_index)
+        {
+            low = mid + 1u;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    // The first note is loaded before sample 0, so it is always a candidate
+    return (low > first) ? low - 1u : first;
+}
+
+/**
+ * Parse all notes for a single channel, and record the input stream and start sample of
+ * the first note that the channel has in each block, in a seek index
+ *
+ * @param parser         Pointer to initialized parser object
+ * @param sample_rate    Sampling rate to calculate note lengths with
+ * @param index          Pointer to seek index being built
+ * @param channel_idx    Index of channel to scan
+ * @param last_sample    Pointer to location to store index of last sample (see
+ *                       _channel_last_sample), unchanged if the channel has no notes
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+static int _index_channel_blocks(ptttl_parser_t *parser, unsigned int sample_rate, ptttl_seek_index_t *index,
+                                 uint32_t channel_idx, uint64_t *last_sample)
+{
+    ptttl_seek_index_entry_t *entries = &index->entries[(size_t) channel_idx * index->block_count];
+    uint32_t entry_count = 0u;
+    uint64_t start_sample = 0u;
+    uint8_t first_note = 1u;
+    ptttl_output_note_t note;
+    int ret = 0;
+
+    while (1)
+    {
+        ptttl_parser_input_stream_t stream = parser->channels[channel_idx];
+        ret = ptttl_parse_next(parser, channel_idx, &note);
+        if (ret != 0)
+        {
+            break;
+        }
+
+        if ((0u == entry_count) || (entries[entry_count - 1u].stream.block != stream.block))
+        {
+            // First note of a new block on this channel
+            if (entry_count == index->block_count)
+            {
+                ERROR(parser, "Seek index was initialized for a different PTTTL source text");
+                return -1;
+            }
+
+            entries[entry_count].stream = stream;
+            entries[entry_count].start_sample = start_sample;
+            entry_count += 1u;
+        }
+
+        // Track note start samples in the same way as _compile_channel
+        unsigned int num_samples = _note_num_samples(sample_rate, &note);
+        if (1u == first_note)
+        {
+            start_sample = num_samples;
+            first_note = 0u;
+        }
+        else
+        {
+            start_sample += (0u == num_samples) ? 1u : num_samples;
+        }
+    }
+
+    if (ret < 0)
+    {
+        _error = ptttl_parser_error(parser);
+        return ret;
+    }
+
+    index->channel_entries[channel_idx] = entry_count;
+
+    if (0u == first_note)
+    {
+        *last_sample = start_sample;
+    }
+
+    return 0;
+}
+
+/**
+ * Build the seek index of a sample generator for its sampling rate, by parsing the
+ * whole input text once
+ *
+ * @param generator    Pointer to sample generator with a seek index
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+static int _build_seek_index(ptttl_sample_generator_t *generator)
+{
+    ptttl_seek_index_t *index = generator->config.seek_index;
+    ptttl_parser_t *parser = generator->parser;
+    uint64_t total = 0u;
+
+    // Mark the index as not built, in case building it fails partway through
+    index->sample_rate = 0u;
+
+    for (uint32_t chan = 0u; chan < parser->channel_count; chan++)
+    {
+        // Leave the parser positioned at the start of each channel, as for ptttl_compute_total_samples
+        ptttl_parser_input_stream_t saved_stream = parser->channels[chan];
+        uint64_t last_sample = UINT64_MAX;
+
+        int ret = _index_channel_blocks(parser, generator->config.sample_rate, index, chan, &last_sample);
+        parser->channels[chan] = saved_stream;
+        parser->active_stream = &parser->stream;
+
+        if (ret < 0)
+        {
+            return ret;
+        }
+
+        if ((UINT64_MAX != last_sample) && ((last_sample + 1u) > total))
+        {
+            total = last_sample + 1u;
+        }
+    }
+
+    index->total_samples = total;
+    index->sample_rate = generator->config.sample_rate;
+    return 0;
+}
+
+/**
+ * Find the last block of a channel in a seek index whose first note is loaded before a
+ * given sample, i.e. the block that holds the note playing on that sample (or the last
+ * block, if the channel has finished)
+ *
+ * @param index         Pointer to built seek index with at least one entry for the channel
+ * @param channel_idx   Index of channel to search
+ * @param sample_index  Sample index to search for
+ *
+ * @return Index of the entry for the block, within the channel's entries
+ */
+static uint32_t _find_seek_block(const ptttl_seek_index_t *index, uint32_t channel_idx, uint64_t sample_index)
+{
+    const ptttl_seek_index_entry_t *entries = &index->entries[(size_t) channel_idx * index->block_count];
+    uint32_t low = 0u;
+    uint32_t high = index->channel_entries[channel_idx];
+
+    // Find the first block loaded on or after the sample
+    while (low < high)
+    {
+        uint32_t mid = low + ((high - low) / 2u);
+        if (entries[mid].start_sample < sample_index)
+        {
+            low = mid + 1u;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    // The first note is loaded before sample 0, so the first block is always a candidate
+    return (low > 0u) ? low - 1u : 0u;
+}
+
+/**
+ * Set the oscillator state of a voice as if a given number of samples had already been
+ * generated for its note. Notes without vibrato are generated directly from the sample
+ * index, but notes with vibrato accumulate their phase one sample at a time, so the
+ * phase is advanced through each skipped sample of the note (without calculating any
+ * sample values) to get exactly the phase that generating them would have left.
+ *
+ * @param voices         Pointer to voice state of sample generator
+ * @param channel_idx    Channel index of voice
+ * @param sample_rate    Sampling rate
+ * @param steps          Number of samples generated since the note was loaded
+ */
+static void _skip_voice_phase(ptttl_voice_state_t *voices, uint32_t channel_idx, float sample_rate,
+                              uint32_t steps)
+{
+    voices->sine_index[channel_idx] = steps;
+
+    if ((0.0f != voices->vibrato_freq[channel_idx]) || (0.0f != voices->vibrato_var[channel_idx]))
+    {
+        for (uint32_t sine_index = 0u; sine_index < steps; sine_index++)
+        {
+            _advance_vibrato_phasor(voices, channel_idx, sample_rate, sine_index);
+        }
+    }
+}
+
+/**
+ * Load the note that is playing on a single channel at a given sample, as if all
+ * samples before it had been generated
+ *
+ * @param generator      Pointer to initialized sample generator
+ * @param channel_idx    Channel index of channel to seek
+ * @param sample_index   Index of the next sample to be generated
+ *
+ * @return 0 if a note was loaded, 1 if the channel has finished before the sample,
+ *         and -1 if an error occurred
+ */
+static int _seek_channel(ptttl_sample_generator_t *generator, uint32_t channel_idx, uint64_t sample_index)
+{
+    ptttl_note_prefetch_queue_t *queue = &generator->prefetch_queues[channel_idx];
+    const ptttl_timeline_t *timeline = generator->config.timeline;
+    const ptttl_seek_index_t *index = generator->config.seek_index;
+    uint8_t first_note = 1u;
+    uint64_t start_sample = 0u;
+
+    _release_cached_note(generator, channel_idx);
+
+    // Rewind the channel, straight to the right note or block if their start samples are known
+    if (NULL != timeline)
+    {
+        queue->next_event = _find_timeline_note(timeline, channel_idx, sample_index);
+        first_note = (timeline->channel_events[channel_idx] == queue->next_event);
+    }
+    else
+    {
+        ptttl_parser_input_stream_t stream = queue->first_stream;
+
+        if ((NULL != index) && (0u < index->channel_entries[channel_idx]))
+        {
+            uint32_t block = _find_seek_block(index, channel_idx, sample_index);
+            const ptttl_seek_index_entry_t *entry = &index->entries[((size_t) channel_idx * index->block_count) + block];
+
+            stream = entry->stream;
+            start_sample = entry->start_sample;
+            first_note = (0u == block);
+        }
+
+        generator->parser->channels[channel_idx] = stream;
+        queue->head = 0u;
+        queue->count = 0u;
+        queue->parser_finished = 0u;
+    }
+
+    ptttl_timeline_event_t event;
+    int ret = _take_next_note(generator, channel_idx, &event);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    if (NULL != timeline)
+    {
+        start_sample = (1u == first_note) ? 0u : event.start_sample;
+    }
+
+    /* Skip notes until the one that is loaded before the sample; each note ends on
+     * the sample that the next note is loaded on (see _channel_last_sample) */
+    while (1)
+    {
+        uint64_t end_sample = start_sample + event.num_samples;
+        if ((0u == first_note) && (0u == event.num_samples))
+        {
+            end_sample += 1u;
+        }
+
+        if (end_sample >= sample_index)
+        {
+            break;
+        }
+
+        ret = _take_next_note(generator, channel_idx, &event);
+        if (ret != 0)
+        {
+            return ret;
+        }
+
+        start_sample = end_sample;
+        first_note = 0u;
+    }
+
+    uint32_t first_elapsed = (1u == first_note) ? 0u : 1u;
+    uint32_t elapsed = (uint32_t) (sample_index - start_sample);
+
+    _load_note_stream(generator, &event, first_elapsed);
+    generator->note_streams[channel_idx].start_sample = start_sample;
+    generator->voices.elapsed[channel_idx] = elapsed;
+
+    if (NULL != generator->note_streams[channel_idx].cached_samples)
+    {
+        generator->note_streams[channel_idx].cached_position = elapsed - first_elapsed;
+    }
+    else
+    {
+        _skip_voice_phase(&generator->voices, channel_idx, (float) generator->config.sample_rate,
+                          elapsed - first_elapsed);
+    }
+
+    return 0;
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+ptttl_parser_error_t ptttl_sample_generator_error(void)
+{
+    return _error;
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+int ptttl_sample_generator_create(ptttl_parser_t *parser, ptttl_sample_generator_t *generator,
+                                  ptttl_sample_generator_config_t *config)
+{
+    if (NULL == parser)
+    {
+        return -1;
+    }
+
+    if ((NULL == generator) || (NULL == config))
+    {
+        ERROR(parser, "NULL pointer passed to function");
+        return -1;
+    }
+
+    if (0u == parser->channel_count)
+    {
+        ERROR(parser, "PTTTL parser object has a channel count of 0");
+        return -1;
+    }
+
+    if ((config->amplitude > 1.0f) || (config->amplitude < 0.0f))
+    {
+        ERROR(parser, "Sample generator amplitude must be between 0.0 - 1.0");
+        return -1;
+    }
+
+    if (0u == ptttl_sample_format_size(config->sample_format))
+    {
+        ERROR(parser, "Invalid sample format");
+        return -1;
+    }
+
+    if (PTTTL_MAX_OUTPUT_CHANNELS < config->output_channels)
+    {
+        ERROR(parser, "Invalid number of output channels");
+        return -1;
+    }
+
+    if (!(_reference_pitch(config) > 0.0f))
+    {
+        ERROR(parser, "Reference pitch must be greater than 0.0");
+        return -1;
+    }
+
+    uint8_t *storage = (uint8_t *) config->channel_storage;
+    size_t storage_size = config->channel_storage_size;
+
+    if (NULL == storage)
+    {
+#if PTTTL_MAX_CHANNELS_PER_FILE > 0
+        storage = (uint8_t *) generator->channel_storage;
+        storage_size = sizeof(generator->channel_storage);
+#else
+        ERROR(parser, "No built-in channel storage, channel storage must be provided");
+        return -1;
+#endif // PTTTL_MAX_CHANNELS_PER_FILE > 0
+    }
+
+    if (storage_size < ptttl_sample_generator_storage_size(parser->channel_count))
+    {
+        ERROR(parser, "Channel storage too small for PTTTL channel count");
+        return -1;
+    }
+
+    // Align start of channel storage for voice state arrays
+    storage += (PTTTL_VOICE_STATE_ALIGN - ((uintptr_t) storage % PTTTL_VOICE_STATE_ALIGN)) % PTTTL_VOICE_STATE_ALIGN;
+
+    // Divide channel storage between the per-channel arrays, voice state arrays first
+    uint32_t channel_count = parser->channel_count;
+    size_t voice_array_size = PTTTL_VOICE_ARRAY_SIZE(channel_count);
+    float **float_arrays[] = {&generator->voices.phasor, &generator->voices.pitch_hz,
+                              &generator->voices.vibrato_freq, &generator->voices.vibrato_var};
+    uint32_t **uint_arrays[] = {&generator->voices.sine_index, &generator->voices.elapsed,
+                                &generator->voices.length, &generator->voices.attack,
+                                &generator->voices.decay};
+
+    for (uint32_t i = 0u; i < (sizeof(float_arrays) / sizeof(float_arrays[0])); i++)
+    {
+        *float_arrays[i] = (float *) storage;
+        storage += voice_array_size;
+    }
+
+    for (uint32_t i = 0u; i < (sizeof(uint_arrays) / sizeof(uint_arrays[0])); i++)
+    {
+        *uint_arrays[i] = (uint32_t *) storage;
+        storage += voice_array_size;
+    }
+
+    /* Voices are rendered in blocks of PTTTL_VOICE_LANES, so voice state must be valid
+     * for all lanes, including the padding lanes after the last channel */
+    memset(generator->voices.phasor, 0, voice_array_size * PTTTL_VOICE_STATE_ARRAY_COUNT);
+
+    /* The remaining arrays are packed without padding, in order of decreasing alignment;
+     * voice state arrays end on a multiple of PTTTL_VOICE_STATE_ALIGN (at least 8), and
+     * the size of each array is a multiple of its own alignment, so every array starts
+     * suitably aligned */
+    generator->note_streams = (ptttl_note_stream_t *) storage;
+    storage += sizeof(ptttl_note_stream_t) * channel_count;
+    generator->prefetch_queues = (ptttl_note_prefetch_queue_t *) storage;
+    storage += sizeof(ptttl_note_prefetch_queue_t) * channel_count;
+    generator->channel_gains = (float (*)[PTTTL_MAX_OUTPUT_CHANNELS]) storage;
+    storage += sizeof(float) * PTTTL_MAX_OUTPUT_CHANNELS * channel_count;
+    generator->active_channels = (uint32_t *) storage;
+    storage += sizeof(uint32_t) * channel_count;
+    generator->sounding_channels = (uint32_t *) storage;
+    storage += sizeof(uint32_t) * channel_count;
+    generator->channel_finished = storage;
+
+    // Copy config data into generator object
+    generator->config = *config;
+    generator->config.channel_gains = NULL;
+
+    // 0 output channels means mono, as it did before output channels were configurable
+    if (0u == generator->config.output_channels)
+    {
+        generator->config.output_channels = 1u;
+    }
+
+    generator->config.reference_pitch_hz = _reference_pitch(config);
+
+    _init_pitch_table(&generator->config, generator->note_pitches);
+
+    const ptttl_timeline_t *timeline = config->timeline;
+    if ((NULL != timeline) &&
+        ((timeline->channel_count != parser->channel_count) || (timeline->sample_rate != config->sample_rate) ||
+         (timeline->attack_samples != config->attack_samples) || (timeline->decay_samples != config->decay_samples) ||
+         (timeline->reference_pitch_hz != generator->config.reference_pitch_hz)))
+    {
+        ERROR(parser, "Timeline was compiled for a different PTTTL channel count or configuration");
+        return -1;
+    }
+
+    ptttl_seek_index_t *index = config->seek_index;
+    if ((NULL != index) && (index->channel_count != parser->channel_count))
+    {
+        ERROR(parser, "Seek index was initialized for a different PTTTL channel count");
+        return -1;
+    }
+
+    if (NULL != generator->config.note_cache)
+    {
+        _attach_note_cache(generator);
+    }
+
+    // Copy routing gains, so the per-sample mix only needs a multiply-add per output channel
+    uint32_t output_channels = generator->config.output_channels;
+    for (uint32_t chan = 0u; chan < parser->channel_count; chan++)
+    {
+        for (uint32_t output = 0u; output < output_channels; output++)
+        {
+            float gain = 1.0f;
+            if (NULL != config->channel_gains)
+            {
+                gain = config->channel_gains[(chan * output_channels) + output];
+            }
+
+            generator->channel_gains[chan][output] = gain;
+        }
+    }
+    generator->parser = parser;
+
+    generator->current_sample = 0u;
+    generator->next_block = 0u;
+    generator->copy_remaining = 0u;
+    generator->store_remaining = 0u;
+
+    if (NULL != generator->config.block_cache)
+    {
+        int ret = _scan_blocks(generator);
+        if (ret < 0)
+        {
+            return ret;
+        }
+    }
+
+    // The seek index only needs building once for each sampling rate
+    if ((NULL != index) && (index->sample_rate != config->sample_rate))
+    {
+        int ret = _build_seek_index(generator);
+        if (ret < 0)
+        {
+            return ret;
+        }
+    }
+
+    memset(generator->channel_finished, 0, sizeof(uint8_t) * channel_count);
+    memset(generator->note_streams, 0, sizeof(ptttl_note_stream_t) * channel_count);
+    memset(generator->prefetch_queues, 0, sizeof(ptttl_note_prefetch_queue_t) * channel_count);
+
+    for (uint32_t chan = 0u; chan < channel_count; chan++)
+    {
+        if (NULL != timeline)
+        {
+            generator->prefetch_queues[chan].next_event = timeline->channel_events[chan];
+        }
+
+        generator->prefetch_queues[chan].first_stream = parser->channels[chan];
+    }
+
+    int ret = ptttl_sample_generator_prefetch(generator);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    // Populate note streams for initial note on all channels
+    for (uint32_t chan = 0u; chan < parser->channel_count; chan++)
+    {
+        // First note on each channel starts on the first sample
+        ret = _load_next_note(generator, chan, 0u);
+        if (ret != 0)
+        {
+            return ret;
+        }
+
+        generator->active_channels[chan] = chan;
+    }
+
+    generator->active_count = parser->channel_count;
+    _update_voice_lists(generator);
+
+    return 0;
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+size_t ptttl_sample_generator_storage_size(uint32_t channel_count)
+{
+    return PTTTL_SAMPLE_GENERATOR_STORAGE_SIZE(channel_count);
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+int ptttl_note_cache_init(ptttl_note_cache_t *cache, void *storage, size_t storage_size,
+                          uint32_t slot_count, uint32_t slot_samples)
+{
+    if ((NULL == cache) || (NULL == storage) || (0u == slot_count) || (0u == slot_samples))
+    {
+        return -1;
+    }
+
+    if (storage_size < ptttl_note_cache_storage_size(slot_count, slot_samples))
+    {
+        return -1;
+    }
+
+    // Align start of storage for cache entries and samples
+    uint8_t *aligned = (uint8_t *) storage;
+    aligned += (sizeof(uint32_t) - ((uintptr_t) aligned % sizeof(uint32_t))) % sizeof(uint32_t);
+
+    cache->entries = (ptttl_note_cache_entry_t *) aligned;
+    cache->samples = (float *) &aligned[sizeof(ptttl_note_cache_entry_t) * slot_count];
+    cache->slot_count = slot_count;
+    cache->slot_samples = slot_samples;
+    cache->use_counter = 0u;
+    cache->hits = 0u;
+    cache->misses = 0u;
+    cache->oversized = 0u;
+    cache->sample_rate = 0u;
+    cache->attack_samples = 0u;
+    cache->decay_samples = 0u;
+    cache->amplitude = 0.0f;
+    cache->reference_pitch_hz = 0.0f;
+
+    memset(cache->entries, 0, sizeof(ptttl_note_cache_entry_t) * slot_count);
+
+    return 0;
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+size_t ptttl_note_cache_storage_size(uint32_t slot_count, uint32_t slot_samples)
+{
+    return PTTTL_NOTE_CACHE_STORAGE_SIZE(slot_count, slot_samples);
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+int ptttl_block_cache_init(ptttl_block_cache_t *cache, ptttl_parser_t *parser,
+                           void *storage, size_t storage_size)
+{
+    if (NULL == parser)
+    {
+        return -1;
+    }
+
+    if ((NULL == cache) || (NULL == storage))
+    {
+        ERROR(parser, "NULL pointer passed to function");
+        return -1;
+    }
+
+    uint32_t block_count = 0u;
+    if (0 != ptttl_parse_block_fingerprints(parser, NULL, 0u, &block_count))
+    {
+        _error = ptttl_parser_error(parser);
+        return -1;
+    }
+
+    size_t table_size = ptttl_block_cache_storage_size(block_count, 0u);
+    if (storage_size < table_size)
+    {
+        ERROR(parser, "Block cache storage too small for PTTTL block count");
+        return -1;
+    }
+
+    // Align start of storage for fingerprints and cache entries
+    uint8_t *aligned = (uint8_t *) storage;
+    aligned += (sizeof(uint64_t) - ((uintptr_t) aligned % sizeof(uint64_t))) % sizeof(uint64_t);
+
+    cache->fingerprints = (uint64_t *) aligned;
+    aligned += sizeof(uint64_t) * block_count;
+    cache->entries = (ptttl_block_cache_entry_t *) aligned;
+    aligned += sizeof(ptttl_block_cache_entry_t) * block_count;
+    cache->block_count = block_count;
+    cache->pcm = aligned;
+    cache->pcm_size = storage_size - table_size;
+    cache->copied_samples = 0u;
+
+    if (0 != ptttl_parse_block_fingerprints(parser, cache->fingerprints, block_count, &block_count))
+    {
+        _error = ptttl_parser_error(parser);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+size_t ptttl_block_cache_storage_size(uint32_t block_count, size_t pcm_size)
+{
+    return PTTTL_BLOCK_CACHE_STORAGE_SIZE(block_count, pcm_size);
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+int ptttl_seek_index_init(ptttl_seek_index_t *index, ptttl_parser_t *parser,
+                          void *storage, size_t storage_size)
+{
+    if (NULL == parser)
+    {
+        return -1;
+    }
+
+    if ((NULL == index) || (NULL == storage))
+    {
+        ERROR(parser, "NULL pointer passed to function");
+        return -1;
+    }
+
+    uint32_t block_count = 0u;
+    if (0 != ptttl_parse_block_fingerprints(parser, NULL, 0u, &block_count))
+    {
+        _error = ptttl_parser_error(parser);
+        return -1;
+    }
+
+    if (storage_size < ptttl_seek_index_storage_size(parser->channel_count, block_count))
+    {
+        ERROR(parser, "Seek index storage too small for PTTTL block count");
+        return -1;
+    }
+
+    // Align start of storage for index entries
+    uint8_t *aligned = (uint8_t *) storage;
+    aligned += (sizeof(uint64_t) - ((uintptr_t) aligned % sizeof(uint64_t))) % sizeof(uint64_t);
+
+    index->entries = (ptttl_seek_index_entry_t *) aligned;
+    aligned += sizeof(ptttl_seek_index_entry_t) * (size_t) parser->channel_count * block_count;
+    index->channel_entries = (uint32_t *) aligned;
+    index->block_count = block_count;
+    index->channel_count = parser->channel_count;
+    index->total_samples = 0u;
+    index->sample_rate = 0u;
+
+    return 0;
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+size_t ptttl_seek_index_storage_size(uint32_t channel_count, uint32_t block_count)
+{
+    return PTTTL_SEEK_INDEX_STORAGE_SIZE(channel_count, block_count);
+}
+
+/**
+ * Parse all notes for a single channel, and find the index of the last sample that the
+ * sample generator would produce for the channel
+ *
+ * @param parser         Pointer to initialized parser object
+ * @param config         Pointer to sample generator configuration data
+ * @param channel_idx    Index of channel to scan
+ * @param last_sample    Pointer to location to store index of last sample
+ *
+ * @return 0 if successful, 1 if the channel has no notes, -1 if an error occurred
+ */
+static int _channel_last_sample(ptttl_parser_t *parser, ptttl_sample_generator_config_t *config,
+                                uint32_t channel_idx, uint64_t *last_sample)
+{
+    ptttl_output_note_t note;
+    int ret = ptttl_parse_next(parser, channel_idx, &note);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    /* Track the index of the last sample of the current note, the same way that
+     * ptttl_sample_generator_generate does; the first note on each channel runs from
+     * sample 0 through to its last sample inclusive, and each following note starts
+     * on the sample after the last sample of the previous note, and runs for at least
+     * one sample */
+    uint64_t last = _note_num_samples(config->sample_rate, &note);
+
+    while ((ret = ptttl_parse_next(parser, channel_idx, &note)) == 0)
+    {
+        unsigned int num_samples = _note_num_samples(config->sample_rate, &note);
+        last += (0u == num_samples) ? 1u : num_samples;
+    }
+
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    *last_sample = last;
+    return 0;
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+int ptttl_compute_total_samples(ptttl_parser_t *parser, ptttl_sample_generator_config_t *config,
+                                uint64_t *total_samples)
+{
+    if (NULL == parser)
+    {
+        return -1;
+    }
+
+    if ((NULL == config) || (NULL == total_samples))
+    {
+        ERROR(parser, "NULL pointer passed to function");
+        return -1;
+    }
+
+    uint64_t total = 0u;
+
+    for (uint32_t chan = 0u; chan < parser->channel_count; chan++)
+    {
+        /* Save the input stream for this channel, and restore it once the channel has
+         * been scanned, so that the caller's parser is left positioned at the start of
+         * each channel */
+        ptttl_parser_input_stream_t saved_stream = parser->channels[chan];
+        uint64_t last_sample = 0u;
+
+        int ret = _channel_last_sample(parser, config, chan, &last_sample);
+        parser->channels[chan] = saved_stream;
+        parser->active_stream = &parser->stream;
+
+        if (ret < 0)
+        {
+            _error = ptttl_parser_error(parser);
+            return ret;
+        }
+        else if (ret == 1)
+        {
+            continue;
+        }
+
+        if ((last_sample + 1u) > total)
+        {
+            total = last_sample + 1u;
+        }
+    }
+
+    *total_samples = total;
+    return 0;
+}
+
+/**
+ * Parse all notes for a single channel, and compile each one into the next event of a
+ * timeline, recording the sample on which it is loaded
+ *
+ * @param parser            Pointer to initialized parser object
+ * @param config            Pointer to sample generator configuration data
+ * @param note_pitches      Pointer to note pitch table (see _init_pitch_table)
+ * @param channel_idx       Index of channel to compile
+ * @param timeline          Pointer to timeline being compiled
+ * @param event_index       Pointer to index of the next event to compile, updated on return
+ * @param last_sample       Pointer to location to store index of last sample (see
+ *                          _channel_last_sample), unchanged if the channel has no notes
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+static int _compile_channel(ptttl_parser_t *parser, ptttl_sample_generator_config_t *config,
+                            const float *note_pitches, uint32_t channel_idx,
+                            ptttl_timeline_t *timeline, uint32_t *event_index, uint64_t *last_sample)
+{
+    /* Notes are loaded while generating the last sample of the previous note, in the same
+     * way as _channel_last_sample tracks it; the first note is loaded before sample 0 */
+    uint64_t start_sample = 0u;
+    uint8_t first_note = 1u;
+    ptttl_output_note_t note;
+    int ret = 0;
+
+    while ((ret = ptttl_parse_next(parser, channel_idx, &note)) == 0)
+    {
+        if (*event_index == timeline->event_count)
+        {
+            ERROR(parser, "Timeline storage too small for PTTTL event count");
+            return -1;
+        }
+
+        ptttl_timeline_event_t *event = &timeline->events[*event_index];
+        _compile_note(config, note_pitches, &note, channel_idx, event);
+        event->start_sample = start_sample;
+        *event_index += 1u;
+
+        if (1u == first_note)
+        {
+            start_sample = event->num_samples;
+            first_note = 0u;
+        }
+        else
+        {
+            start_sample += (0u == event->num_samples) ? 1u : event->num_samples;
+        }
+    }
+
+    if (ret < 0)
+    {
+        _error = ptttl_parser_error(parser);
+        return ret;
+    }
+
+    if (0u == first_note)
+    {
+        *last_sample = start_sample;
+    }
+
+    return 0;
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+int ptttl_timeline_count_events(ptttl_parser_t *parser, uint32_t *event_count)
+{
+    if (NULL == parser)
+    {
+        return -1;
+    }
+
+    if (NULL == event_count)
+    {
+        ERROR(parser, "NULL pointer passed to function");
+        return -1;
+    }
+
+    uint32_t count = 0u;
+
+    for (uint32_t chan = 0u; chan < parser->channel_count; chan++)
+    {
+        // Leave the parser positioned at the start of each channel, as for ptttl_compute_total_samples
+        ptttl_parser_input_stream_t saved_stream = parser->channels[chan];
+        ptttl_output_note_t note;
+        int ret = 0;
+
+        while ((ret = ptttl_parse_next(parser, chan, &note)) == 0)
+        {
+            count += 1u;
+        }
+
+        parser->channels[chan] = saved_stream;
+        parser->active_stream = &parser->stream;
+
+        if (ret < 0)
+        {
+            _error = ptttl_parser_error(parser);
+            return ret;
+        }
+    }
+
+    *event_count = count;
+    return 0;
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+size_t ptttl_timeline_storage_size(uint32_t channel_count, uint32_t event_count)
+{
+    return PTTTL_TIMELINE_STORAGE_SIZE(channel_count, event_count);
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+int ptttl_timeline_compile(ptttl_parser_t *parser, ptttl_sample_generator_config_t *config,
+                           ptttl_timeline_t *timeline, void *storage, size_t storage_size)
+{
+    if (NULL == parser)
+    {
+        return -1;
+    }
+
+    if ((NULL == config) || (NULL == timeline) || (NULL == storage))
+    {
+        ERROR(parser, "NULL pointer passed to function");
+        return -1;
+    }
+
+    if (!(_reference_pitch(config) > 0.0f))
+    {
+        ERROR(parser, "Reference pitch must be greater than 0.0");
+        return -1;
+    }
+
+    uint32_t event_count = 0u;
+    int ret = ptttl_timeline_count_events(parser, &event_count);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    if (storage_size < ptttl_timeline_storage_size(parser->channel_count, event_count))
+    {
+        ERROR(parser, "Timeline storage too small for PTTTL event count");
+        return -1;
+    }
+
+    // Align start of storage for events
+    uint8_t *aligned = (uint8_t *) storage;
+    aligned += (sizeof(uint64_t) - ((uintptr_t) aligned % sizeof(uint64_t))) % sizeof(uint64_t);
+
+    timeline->events = (ptttl_timeline_event_t *) aligned;
+    timeline->channel_events = (uint32_t *) &aligned[sizeof(ptttl_timeline_event_t) * event_count];
+    timeline->event_count = event_count;
+    timeline->channel_count = parser->channel_count;
+    timeline->sample_rate = config->sample_rate;
+    timeline->attack_samples = config->attack_samples;
+    timeline->decay_samples = config->decay_samples;
+    timeline->reference_pitch_hz = _reference_pitch(config);
+
+    float note_pitches[PTTTL_NOTE_PITCH_TABLE_SIZE];
+    _init_pitch_table(config, note_pitches);
+
+    uint32_t event_index = 0u;
+    uint64_t total = 0u;
+
+    for (uint32_t chan = 0u; chan < parser->channel_count; chan++)
+    {
+        ptttl_parser_input_stream_t saved_stream = parser->channels[chan];
+        uint64_t last_sample = UINT64_MAX;
+
+        timeline->channel_events[chan] = event_index;
+        ret = _compile_channel(parser, config, note_pitches, chan, timeline, &event_index, &last_sample);
+        parser->channels[chan] = saved_stream;
+        parser->active_stream = &parser->stream;
+
+        if (ret < 0)
+        {
+            return ret;
+        }
+
+        if ((UINT64_MAX != last_sample) && ((last_sample + 1u) > total))
+        {
+            total = last_sample + 1u;
+        }
+    }
+
+    timeline->channel_events[parser->channel_count] = event_index;
+    timeline->event_count = event_index;
+    timeline->total_samples = total;
+
+    return 0;
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+int ptttl_sample_generator_prefetch(ptttl_sample_generator_t *generator)
+{
+    if (NULL == generator)
+    {
+        return -1;
+    }
+
+    // Notes in a timeline are already compiled, so there is nothing to parse
+    if (NULL != generator->config.timeline)
+    {
+        return 0;
+    }
+
+    for (uint32_t chan = 0u; chan < generator->parser->channel_count; chan++)
+    {
+        if (_prefetch_channel(generator, chan, PTTTL_NOTE_PREFETCH_COUNT) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+int ptttl_sample_generator_seek(ptttl_sample_generator_t *generator, uint64_t sample_index)
+{
+    if (NULL == generator)
+    {
+        return -1;
+    }
+
+    uint32_t channel_count = generator->parser->channel_count;
+
+    // Stop copying or storing any cached block, the next block to start is found again below
+    generator->next_block = 0u;
+    generator->copy_remaining = 0u;
+    generator->store_remaining = 0u;
+
+    for (uint32_t chan = 0u; chan < channel_count; chan++)
+    {
+        int ret = _seek_channel(generator, chan, sample_index);
+        if (ret < 0)
+        {
+            return ret;
+        }
+
+        generator->channel_finished[chan] = (uint8_t) ret;
+        generator->active_channels[chan] = chan;
+    }
+
+    generator->active_count = channel_count;
+    _update_voice_lists(generator);
+    generator->current_sample = sample_index;
+
+    if (NULL != generator->config.block_cache)
+    {
+        _start_cached_block(generator, 1u);
+    }
+
+    return 0;
+}
+
+#if PTTTL_VOICE_LANES > 0u
+/**
+ * Calculate the sample values for a run of consecutive samples of a block of
+ * #PTTTL_VOICE_LANES neighbouring voices, and advance their oscillator and envelope
+ * state. Produces the same results as _voice_sample_value for each voice, but is written
+ * so that compilers can vectorize the inner loop with one voice per SIMD lane; voice
+ * state is copied into local arrays (which cannot alias) once per run, processed without
+ * branches, and copied back. Voices that are resting or finished are processed too,
+ * which is harmless since their state is reset when their next note is loaded, and
+ * their sample values are simply not mixed.
+ *
+ * @param voices         Pointer to voice state of sample generator
+ * @param first_voice    Channel index of first voice in the block, multiple of #PTTTL_VOICE_LANES
+ * @param sample_rate    Sampling rate
+ * @param amplitude      Amplitude of generated samples, between 0.0-1.0
+ * @param frame_count    Number of samples to generate for each voice, no more than
+ *                       #VOICE_RUN_FRAMES
+ * @param lane_samples   Pointer to location to store sample values, one row of
+ *                       #PTTTL_VOICE_LANES values for each sample
+ */
+static void _voice_block_sample_values(ptttl_voice_state_t *voices, uint32_t first_voice,
+                                       float sample_rate, float amplitude, uint32_t frame_count,
+                                       float lane_samples[][PTTTL_VOICE_LANES])
+{
+    float phasor[PTTTL_VOICE_LANES];
+    float pitch_hz[PTTTL_VOICE_LANES];
+    float vibrato_freq[PTTTL_VOICE_LANES];
+    float vibrato_var[PTTTL_VOICE_LANES];
+    uint32_t sine_index[PTTTL_VOICE_LANES];
+    uint32_t elapsed[PTTTL_VOICE_LANES];
+    uint32_t length[PTTTL_VOICE_LANES];
+    uint32_t attack[PTTTL_VOICE_LANES];
+    uint32_t decay[PTTTL_VOICE_LANES];
+
+    memcpy(phasor, &voices->phasor[first_voice], sizeof(phasor));
+    memcpy(pitch_hz, &voices->pitch_hz[first_voice], sizeof(pitch_hz));
+    memcpy(vibrato_freq, &voices->vibrato_freq[first_voice], sizeof(vibrato_freq));
+    memcpy(vibrato_var, &voices->vibrato_var[first_voice], sizeof(vibrato_var));
+    memcpy(sine_index, &voices->sine_index[first_voice], sizeof(sine_index));
+    memcpy(elapsed, &voices->elapsed[first_voice], sizeof(elapsed));
+    memcpy(length, &voices->length[first_voice], sizeof(length));
+    memcpy(attack, &voices->attack[first_voice], sizeof(attack));
+    memcpy(decay, &voices->decay[first_voice], sizeof(decay));
+
+    for (uint32_t frame = 0u; frame < frame_count; frame++)
+    {
+        float *samples = lane_samples[frame];
+
+        for (uint32_t lane = 0u; lane < PTTTL_VOICE_LANES; lane++)
+        {
+            /* Calculate the sample both with and without vibrato, and select one, so that
+             * every lane does the same work */
+            float sine_time = ((float) sine_index[lane]) / sample_rate;
+            float plain_sample = fast_sinf(pitch_hz[lane] * sine_time);
+            float vibrato_sample = fast_sinf(phasor[lane]);
+
+            float vsine = fast_sinf(vibrato_freq[lane] * sine_time);
+            float note_pitch_hz = pitch_hz[lane] + (vibrato_var[lane] * vsine);
+            phasor[lane] += note_pitch_hz / sample_rate;
+            phasor[lane] -= (phasor[lane] >= 1.0f) ? 1.0f : 0.0f;
+            sine_index[lane] += 1u;
+
+            uint8_t vibrato = (0.0f != vibrato_freq[lane]) || (0.0f != vibrato_var[lane]);
+            float raw_sample = vibrato ? vibrato_sample : plain_sample;
+
+            /* Select the attack ratio, decay ratio or 1/1 as integers, so that every lane
+             * does exactly one division, and no lane divides by 0 */
+            uint32_t samples_elapsed = elapsed[lane];
+            uint32_t samples_remaining = length[lane] - samples_elapsed;
+            elapsed[lane] = samples_elapsed + 1u;
+
+            uint32_t numerator = (samples_remaining < decay[lane]) ? samples_remaining : 1u;
+            uint32_t denominator = (samples_remaining < decay[lane]) ? decay[lane] : 1u;
+            numerator = (samples_elapsed < attack[lane]) ? samples_elapsed : numerator;
+            denominator = (samples_elapsed < attack[lane]) ? attack[lane] : denominator;
+
+            raw_sample *= ((float) numerator) / ((float) denominator);
+            samples[lane] = raw_sample * amplitude;
+        }
+    }
+
+    memcpy(&voices->phasor[first_voice], phasor, sizeof(phasor));
+    memcpy(&voices->sine_index[first_voice], sine_index, sizeof(sine_index));
+    memcpy(&voices->elapsed[first_voice], elapsed, sizeof(elapsed));
+}
+#endif // PTTTL_VOICE_LANES > 0u
+
+/**
+ * Generate the next sample for the given note stream on the given channel
+ *
+ * @param generator      Pointer to initialized sample generator
+ * @param stream         Pointer to ptttl_note_stream_t instance to generate a sample for
+ * @param channel_idx    Channel index of channel the generated sample is for
+ * @param sample         Pointer to location to store generated sample
+ *
+ * @return 0 if there are more samples remaining for the provided note stream,
+             1 if no more samples, -1 if an error occurred
+ */
+static int _generate_channel_sample(ptttl_sample_generator_t *generator, ptttl_note_stream_t *stream,
+                                    unsigned int channel_idx, float *sample)
+{
+    int ret = 0;
+
+    // Generate next sample value for this channel, between -1.0 and 1.0
+    if (0u == stream->note_number) // Note number 0 indicates pause/rest
+    {
+        *sample = 0.0f;
+    }
+    else
+    {
+        *sample = _channel_sample_value(generator, channel_idx);
+    }
+
+    // Check if last sample for this note stream
+    if ((generator->current_sample - stream->start_sample) >= stream->num_samples)
+    {
+        // Load the next note for this channel
+        ret = _load_next_note(generator, channel_idx, 1u);
+    }
+
+    return ret;
+}
+
+/**
+ * Find how many samples can be generated, starting from the current sample, before
+ * any unfinished channel reaches the last sample of its current note
+ *
+ * @param generator      Pointer to initialized sample generator
+ *
+ * @return Number of samples until the next note end, or 0 if a note ends on the
+ *         current sample or all channels are finished
+ */
+static uint64_t _samples_until_note_end(ptttl_sample_generator_t *generator)
+{
+    uint64_t span = UINT64_MAX;
+
+    for (uint32_t i = 0u; i < generator->active_count; i++)
+    {
+        ptttl_note_stream_t *stream = &generator->note_streams[generator->active_channels[i]];
+        uint64_t end_sample = stream->start_sample + (uint64_t) stream->num_samples;
+        if (end_sample <= generator->current_sample)
+        {
+            return 0u;
+        }
+
+        if ((end_sample - generator->current_sample) < span)
+        {
+            span = end_sample - generator->current_sample;
+        }
+    }
+
+    return (UINT64_MAX == span) ? 0u : span;
+}
+
+/**
+ * Make sure that every channel whose current note ends on the current sample has its
+ * next note ready in its prefetch queue, so that the per-sample path never has to call
+ * the parser. Only parses one note for each channel whose prefetch queue has run dry;
+ * the queues are filled up again by the next #ptttl_sample_generator_prefetch.
+ *
+ * @param generator      Pointer to initialized sample generator
+ * @param allow_parse    1 to parse the next note of a channel whose prefetch queue has
+ *                       run dry, 0 to report that the queue has run dry instead
+ *
+ * @return 0 if successful, 2 if a prefetch queue has run dry and allow_parse is 0,
+ *         -1 if an error occurred
+ */
+static int _prefetch_ending_channels(ptttl_sample_generator_t *generator, uint8_t allow_parse)
+{
+    // Notes in a timeline are already compiled, so there is nothing to parse
+    if (NULL != generator->config.timeline)
+    {
+        return 0;
+    }
+
+    for (uint32_t i = 0u; i < generator->active_count; i++)
+    {
+        uint32_t chan = generator->active_channels[i];
+        ptttl_note_stream_t *stream = &generator->note_streams[chan];
+
+        if ((generator->current_sample - stream->start_sample) >= stream->num_samples)
+        {
+            ptttl_note_prefetch_queue_t *queue = &generator->prefetch_queues[chan];
+            if ((0u == allow_parse) && (0u == queue->count) && (0u == queue->parser_finished))
+            {
+                return 2;
+            }
+
+            if (_prefetch_channel(generator, chan, 1u) < 0)
+            {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Convert a sample value between -1.0 and 1.0 to the configured output sample format,
+ * and store it in the output sample buffer
+ *
+ * @param format       Output sample format
+ * @param samples      Pointer to output sample buffer
+ * @param index        Index of sample within output sample buffer
+ * @param value        Sample value between -1.0 and 1.0
+ */
+static void _store_output_sample(ptttl_sample_format_e format, void *samples, uint32_t index, float value)
+{
+    switch (format)
+    {
+        case PTTTL_SAMPLE_FORMAT_FLOAT32:
+            ((float *) samples)[index] = value;
+            break;
+        case PTTTL_SAMPLE_FORMAT_S24:
+        {
+            // Packed 3-byte little-endian samples
+            int32_t s24 = (int32_t) (value * (float) MAX_SAMPLE_VALUE_S24);
+            uint8_t *dest = &((uint8_t *) samples)[index * 3u];
+            dest[0] = (uint8_t) (s24 & 0xff);
+            dest[1] = (uint8_t) ((s24 >> 8) & 0xff);
+            dest[2] = (uint8_t) ((s24 >> 16) & 0xff);
+            break;
+        }
+        case PTTTL_SAMPLE_FORMAT_S8:
+            ((int8_t *) samples)[index] = (int8_t) (value * (float) MAX_SAMPLE_VALUE_S8);
+            break;
+        case PTTTL_SAMPLE_FORMAT_U8:
+            ((uint8_t *) samples)[index] = (uint8_t) (((int32_t) (value * (float) MAX_SAMPLE_VALUE_S8))
+                                                      + ZERO_SAMPLE_VALUE_U8);
+            break;
+        case PTTTL_SAMPLE_FORMAT_S16:
+        default:
+            ((int16_t *) samples)[index] = (int16_t) (value * (float) MAX_SAMPLE_VALUE_S16);
+            break;
+    }
+}
+
+/* Defines _generate_span_<N>(), a version of _generate_span specialized for exactly N
+ * sounding voices. The voice loop has a constant trip count so the compiler can fully
+ * unroll it, and the channel indices and gains of the sounding voices are kept in local
+ * variables for the whole span, rather than being looked up again for every sample.
+ * Voices are mixed in the same order as _generate_span, so the results are identical. */
+#define DEFINE_SPECIALIZED_SPAN_GENERATOR(_voice_count)                                         \
+static void _generate_span_##_voice_count(ptttl_sample_generator_t *generator, void *samples,  \
+                                          uint32_t first_frame, uint32_t frame_count)          \
+{                                                                                              \
+    unsigned int output_channels = generator->config.output_channels;                          \
+    float channel_count = (float) generator->parser->channel_count;                            \
+    uint32_t channels[_voice_count];                                                           \
+    float gains[_voice_count][PTTTL_MAX_OUTPUT_CHANNELS];                                      \
+                                                                                               \
+    for (uint32_t i = 0u; i < (_voice_count); i++)                                             \
+    {                                                                                          \
+        channels[i] = generator->sounding_channels[i];                                         \
+        memcpy(gains[i], generator->channel_gains[channels[i]], sizeof(gains[i]));             \
+    }                                                                                          \
+                                                                                               \
+    for (uint32_t samplenum = first_frame; samplenum < (first_frame + frame_count); samplenum++) \
+    {                                                                                          \
+        float summed_samples[PTTTL_MAX_OUTPUT_CHANNELS] = {0.0f};                              \
+                                                                                               \
+        for (uint32_t i = 0u; i < (_voice_count); i++)                                         \
+        {                                                                                      \
+            float chan_sample = _channel_sample_value(generator, channels[i]);                 \
+            for (unsigned int output = 0u; output < output_channels; output++)                 \
+            {                                                                                  \
+                summed_samples[output] += chan_sample * gains[i][output];                      \
+            }                                                                                  \
+        }                                                                                      \
+                                                                                               \
+        for (unsigned int output = 0u; output < output_channels; output++)                     \
+        {                                                                                      \
+            _store_output_sample(generator->config.sample_format, samples,                     \
+                                 (samplenum * output_channels) + output,                       \
+                                 summed_samples[output] / channel_count);                      \
+        }                                                                                      \
+    }                                                                                          \
+                                                                                               \
+    generator->current_sample += frame_count;                                                  \
+}
+
+DEFINE_SPECIALIZED_SPAN_GENERATOR(1)
+DEFINE_SPECIALIZED_SPAN_GENERATOR(2)
+DEFINE_SPECIALIZED_SPAN_GENERATOR(4)
+DEFINE_SPECIALIZED_SPAN_GENERATOR(8)
+
+/**
+ * Generate a run of samples during which no channel reaches the end of its current
+ * note. Only channels that are sounding a note are visited; resting channels contribute
+ * nothing, and if every channel is resting (or finished), the whole run is filled with
+ * silence in one go.
+ *
+ * @param generator      Pointer to initialized sample generator
+ * @param samples        Pointer to output sample buffer
+ * @param first_frame    Index of first frame to generate within output sample buffer
+ * @param frame_count    Number of frames to generate
+ */
+static void _generate_span(ptttl_sample_generator_t *generator, void *samples,
+                           uint32_t first_frame, uint32_t frame_count)
+{
+    unsigned int output_channels = generator->config.output_channels;
+    uint32_t sounding_count = generator->sounding_count;
+
+    if (0u == sounding_count)
+    {
+        // Nothing but rests, output silence for the whole span
+        unsigned int frame_size = ptttl_sample_format_size(generator->config.sample_format) * output_channels;
+        int silence = (PTTTL_SAMPLE_FORMAT_U8 == generator->config.sample_format) ? ZERO_SAMPLE_VALUE_U8 : 0;
+        memset(&((uint8_t *) samples)[first_frame * frame_size], silence, frame_count * frame_size);
+        generator->current_sample += frame_count;
+        return;
+    }
+
+    /* Use a specialized version for common voice counts, unless there are enough
+     * sounding voices that some of them might be rendered in SIMD lanes */
+    if (sounding_count < LANE_MIN_SOUNDING_VOICES)
+    {
+        switch (sounding_count)
+        {
+            case 1u:
+                _generate_span_1(generator, samples, first_frame, frame_count);
+                return;
+            case 2u:
+                _generate_span_2(generator, samples, first_frame, frame_count);
+                return;
+            case 4u:
+                _generate_span_4(generator, samples, first_frame, frame_count);
+                return;
+            case 8u:
+                _generate_span_8(generator, samples, first_frame, frame_count);
+                return;
+            default:
+                break;
+        }
+    }
+
+    /* Generate the span in runs of up to VOICE_RUN_FRAMES samples. Within each run,
+     * voices are mixed one after another in ascending channel order (the same order
+     * as one sample at a time), so the mixed sample values do not depend on how the
+     * span is divided up */
+    for (uint32_t run_start = first_frame; run_start < (first_frame + frame_count); run_start += VOICE_RUN_FRAMES)
+    {
+        float summed_samples[VOICE_RUN_FRAMES][PTTTL_MAX_OUTPUT_CHANNELS];
+        uint32_t run_frames = (first_frame + frame_count) - run_start;
+        if (run_frames > VOICE_RUN_FRAMES)
+        {
+            run_frames = VOICE_RUN_FRAMES;
+        }
+
+        memset(summed_samples, 0, sizeof(summed_samples));
+
+#if PTTTL_VOICE_LANES > 0u
+        float lane_samples[VOICE_RUN_FRAMES][PTTTL_VOICE_LANES];
+        uint32_t lanes_end = 0u;   // Index in sounding_channels after the last voice in lane_samples
+        uint32_t block_start = 0u; // Channel index of first voice in lane_samples
+#endif // PTTTL_VOICE_LANES > 0u
+
+        for (uint32_t i = 0u; i < sounding_count; i++)
+        {
+            uint32_t chan = generator->sounding_channels[i];
+
+#if PTTTL_VOICE_LANES > 0u
+            if (i >= lanes_end)
+            {
+                // Count sounding voices in the same block of PTTTL_VOICE_LANES voices as this one
+                uint32_t block_end = i + 1u;
+                while ((block_end < sounding_count) &&
+                       ((generator->sounding_channels[block_end] / PTTTL_VOICE_LANES) == (chan / PTTTL_VOICE_LANES)))
+                {
+                    block_end += 1u;
+                }
+
+                // Render the whole block in SIMD lanes if at least half of the lanes are needed
+                if ((block_end - i) >= LANE_MIN_SOUNDING_VOICES)
+                {
+                    block_start = chan - (chan % PTTTL_VOICE_LANES);
+                    _voice_block_sample_values(&generator->voices, block_start,
+                                               (float) generator->config.sample_rate,
+                                               generator->config.amplitude, run_frames, lane_samples);
+                    lanes_end = block_end;
+                }
+            }
+
+            // Notes played from the note cache are not taken from SIMD lanes
+            if ((i < lanes_end) && (NULL == generator->note_streams[chan].cached_samples))
+            {
+                for (uint32_t frame = 0u; frame < run_frames; frame++)
+                {
+                    float chan_sample = lane_samples[frame][chan - block_start];
+                    for (unsigned int output = 0u; output < output_channels; output++)
+                    {
+                        summed_samples[frame][output] += chan_sample * generator->channel_gains[chan][output];
+                    }
+                }
+
+                continue;
+            }
+#endif // PTTTL_VOICE_LANES > 0u
+
+            for (uint32_t frame = 0u; frame < run_frames; frame++)
+            {
+                float chan_sample = _channel_sample_value(generator, chan);
+                for (unsigned int output = 0u; output < output_channels; output++)
+                {
+                    summed_samples[frame][output] += chan_sample * generator->channel_gains[chan][output];
+                }
+            }
+        }
+
+        for (uint32_t frame = 0u; frame < run_frames; frame++)
+        {
+            for (unsigned int output = 0u; output < output_channels; output++)
+            {
+                _store_output_sample(generator->config.sample_format, samples,
+                                     ((run_start + frame) * output_channels) + output,
+                                     summed_samples[frame][output] / (float) generator->parser->channel_count);
+            }
+        }
+
+        generator->current_sample += run_frames;
+    }
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+void ptttl_sample_generator_pan(float pan, float *gains)
+{
+    if (NULL == gains)
+    {
+        return;
+    }
+
+    if (pan < -1.0f)
+    {
+        pan = -1.0f;
+    }
+    else if (pan > 1.0f)
+    {
+        pan = 1.0f;
+    }
+
+    /* Map pan position to an angle between 0 and pi/2 (0.0 - 0.25, in the phase units
+     * used by fast_sinf); left gain is the cosine, right gain is the sine */
+    float phase = (pan + 1.0f) * 0.125f;
+    gains[0] = fast_sinf(phase + 0.25f);
+    gains[1] = fast_sinf(phase);
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+unsigned int ptttl_sample_format_size(ptttl_sample_format_e format)
+{
+    switch (format)
+    {
+        case PTTTL_SAMPLE_FORMAT_S16:
+            return 2u;
+        case PTTTL_SAMPLE_FORMAT_FLOAT32:
+            return 4u;
+        case PTTTL_SAMPLE_FORMAT_S24:
+            return 3u;
+        case PTTTL_SAMPLE_FORMAT_S8:
+        case PTTTL_SAMPLE_FORMAT_U8:
+            return 1u;
+        default:
+            return 0u;
+    }
+}
+
+/**
+ * Generate the next audio sample(s) using notes that have already been parsed (see
+ * #ptttl_sample_generator_generate_prefetched and #ptttl_sample_generator_generate_no_parse)
+ *
+ * @param generator        Pointer to initialized generator object
+ * @param num_samples      Pointer to number of sample frames to generate, overwritten
+ *                         with the number of sample frames actually generated
+ * @param samples          Pointer to location to store sample values
+ * @param allow_parse      1 to parse the next note of a channel whose prefetch queue has
+ *                         run dry, 0 to stop generating before the sample that needs it
+ *
+ * @return 0 if successful, 1 if all samples have been generated, 2 if a prefetch queue
+ *         ran dry and allow_parse is 0, and -1 if an error occurred
+ */
+static int _generate_prefetched(ptttl_sample_generator_t *generator, uint32_t *num_samples,
+                                void *samples, uint8_t allow_parse)
+{
+    if (NULL == generator)
+    {
+        return -1;
+    }
+
+    if ((NULL == num_samples) || (NULL == samples))
+    {
+        ERROR(generator->parser, "NULL pointer passed to function");
+        return -1;
+    }
+
+    uint32_t samples_to_generate = *num_samples;
+    *num_samples = 0u;
+
+    int ret = 0;
+    unsigned int output_channels = generator->config.output_channels;
+
+    /* Skipping the notes of a block copied from the block cache needs the parser, unless
+     * the notes come from a timeline. Without the parser, a copy that has not started yet
+     * (e.g. one started by ptttl_sample_generator_seek) is generated as normal instead */
+    uint8_t allow_copy = (1u == allow_parse) || (NULL != generator->config.timeline);
+    if ((0u == allow_copy) && (0u < generator->copy_remaining))
+    {
+        ptttl_block_cache_entry_t *entry = &generator->config.block_cache->entries[generator->cache_block];
+        if ((entry->end_sample - entry->start_sample) == generator->copy_remaining)
+        {
+            generator->copy_remaining = 0u;
+        }
+    }
+
+    uint32_t samplenum = 0u;
+    while (samplenum < samples_to_generate)
+    {
+        if (0u < generator->copy_remaining)
+        {
+            // Block is a repeat of an earlier block, so copy its samples from the block cache
+            uint32_t frames = samples_to_generate - samplenum;
+            if ((uint64_t) frames > generator->copy_remaining)
+            {
+                frames = (uint32_t) generator->copy_remaining;
+            }
+
+            size_t frame_size = ptttl_sample_format_size(generator->config.sample_format) * output_channels;
+            memcpy(&((uint8_t *) samples)[samplenum * frame_size], generator->cache_pcm, frames * frame_size);
+            generator->cache_pcm += frames * frame_size;
+            generator->copy_remaining -= frames;
+            generator->config.block_cache->copied_samples += frames;
+            generator->current_sample += frames;
+            samplenum += frames;
+            *num_samples += frames;
+
+            if (0u == generator->copy_remaining)
+            {
+                ret = _skip_copied_block(generator);
+                if (ret < 0)
+                {
+                    return ret;
+                }
+
+                // The next block may be a repeat too
+                _start_cached_block(generator, allow_copy);
+            }
+
+            continue;
+        }
+
+        /* Samples before the next note end need no end-of-note checks, so generate
+         * them as a single span (skipping rests entirely) */
+        uint64_t span = _samples_until_note_end(generator);
+        if (span > (uint64_t) (samples_to_generate - samplenum))
+        {
+            span = samples_to_generate - samplenum;
+        }
+
+        if (0u < span)
+        {
+            _generate_span(generator, samples, samplenum, (uint32_t) span);
+            _store_block_samples(generator, samples, samplenum, (uint32_t) span);
+            samplenum += (uint32_t) span;
+            *num_samples += (uint32_t) span;
+            continue;
+        }
+
+        // At least one note ends on this sample, so generate it the slow way
+        float summed_samples[PTTTL_MAX_OUTPUT_CHANNELS] = {0.0f};
+
+        if (0u == generator->active_count)
+        {
+            // Finished-- no samples left on any channel
+            return 1;
+        }
+
+        // Make sure the next notes are ready before the per-sample path needs them
+        ret = _prefetch_ending_channels(generator, allow_parse);
+        if (ret != 0)
+        {
+            return ret;
+        }
+
+        // Sum the current state of all unfinished channels to generate the next sample
+        for (uint32_t i = 0u; i < generator->active_count; i++)
+        {
+            uint32_t chan = generator->active_channels[i];
+            ptttl_note_stream_t *stream = &generator->note_streams[chan];
+
+            float chan_sample = 0.0f;
+            ret = _generate_channel_sample(generator, stream, chan, &chan_sample);
+            if (ret < 0)
+            {
+                return ret;
+            }
+
+            generator->channel_finished[chan] = ret;
+
+            for (unsigned int output = 0u; output < output_channels; output++)
+            {
+                summed_samples[output] += chan_sample * generator->channel_gains[chan][output];
+            }
+        }
+
+        // Notes have ended, so some channels may have finished, or started/stopped resting
+        _update_voice_lists(generator);
+
+        generator->current_sample += 1u;
+        for (unsigned int output = 0u; output < output_channels; output++)
+        {
+            _store_output_sample(generator->config.sample_format, samples,
+                                 (samplenum * output_channels) + output,
+                                 summed_samples[output] / (float) generator->parser->channel_count);
+        }
+
+        _store_block_samples(generator, samples, samplenum, 1u);
+
+        // Notes have ended on this sample, so a new block may start on the next sample
+        if (NULL != generator->config.block_cache)
+        {
+            _start_cached_block(generator, allow_copy);
+        }
+
+        *num_samples += 1u;
+        samplenum += 1u;
     }
 
     return 0;
 }
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+int ptttl_sample_generator_generate_prefetched(ptttl_sample_generator_t *generator, uint32_t *num_samples,
+                                               void *samples)
+{
+    return _generate_prefetched(generator, num_samples, samples, 1u);
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+int ptttl_sample_generator_generate_no_parse(ptttl_sample_generator_t *generator, uint32_t *num_samples,
+                                             void *samples)
+{
+    return _generate_prefetched(generator, num_samples, samples, 0u);
+}
+
+/**
+ * @see ptttl_sample_generator.h
+ */
+int ptttl_sample_generator_generate(ptttl_sample_generator_t *generator, uint32_t *num_samples,
+                                    void *samples)
+{
+    // Parse upcoming notes now, so that the sample loop does not have to
+    if (ptttl_sample_generator_prefetch(generator) < 0)
+    {
+        return -1;
+    }
+
+    return ptttl_sample_generator_generate_prefetched(generator, num_samples, samples);
+}
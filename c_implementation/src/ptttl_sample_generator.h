@@ -1,11 +1,12 @@
 /* ptttl_sample_generator.h
  *
- * Converts the output of ptttl_parse_next() into a stream of signed 16-bit audio samples
- * suitable for a WAV file. Samples can be obtained one at a time, at your leisure.
+ * Converts the output of ptttl_parse_next() into a stream of audio samples suitable for
+ * a WAV file (signed 16-bit by default, see ptttl_sample_format_e for other formats).
+ * Samples can be obtained one at a time, at your leisure.
  *
  * Requires ptttl_parser.c
  *
- * Requires stdint.h and memset() from string.h
+ * Requires stdint.h, stddef.h and memset()/memcpy() from string.h
  *
  * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
  *
@@ -17,6 +18,7 @@
 
 
 #include <stdint.h>
+#include <stddef.h>
 #include "ptttl_parser.h"
 
 
@@ -28,27 +30,393 @@
 /**
  * ptttl_sample_generator_config_t object initialization with sane defaults
  */
-#define PTTTL_SAMPLE_GENERATOR_CONFIG_DEFAULT {.sample_rate=44100u, .attack_samples=100u, \
-                                               .decay_samples=500u, .amplitude=0.8f}
+#define PTTTL_SAMPLE_GENERATOR_CONFIG_DEFAULT {.sample_rate=44100u, .attack_samples=100u,     \
+                                               .decay_samples=500u, .amplitude=0.8f,          \
+                                               .sample_format=PTTTL_SAMPLE_FORMAT_S16,        \
+                                               .output_channels=1u, .channel_gains=NULL,      \
+                                               .channel_storage=NULL, .channel_storage_size=0u, \
+                                               .reference_pitch_hz=440.0f, .note_cache=NULL, \
+                                               .block_cache=NULL, .timeline=NULL,             \
+                                               .seek_index=NULL}
+
+/**
+ * ptttl_sample_generator_config_t object initialization for telephony (8kHz sampling
+ * rate). Attack and decay times are the same as the defaults, scaled to 8kHz.
+ */
+#define PTTTL_SAMPLE_GENERATOR_CONFIG_TELEPHONY {.sample_rate=8000u, .attack_samples=18u,        \
+                                                 .decay_samples=91u, .amplitude=0.8f,           \
+                                                 .sample_format=PTTTL_SAMPLE_FORMAT_S16,        \
+                                                 .output_channels=1u, .channel_gains=NULL,      \
+                                                 .channel_storage=NULL, .channel_storage_size=0u, \
+                                                 .reference_pitch_hz=440.0f, .note_cache=NULL, \
+                                                 .block_cache=NULL, .timeline=NULL,             \
+                                                 .seek_index=NULL}
+
+
+/**
+ * Number of parsed notes that are buffered ahead of time for each channel. Notes are
+ * parsed into this buffer by #ptttl_sample_generator_prefetch, outside of the per-sample
+ * path. If the buffer for a channel runs dry partway through generating samples, only
+ * the one note that is needed next is parsed, at the sample where the previous note ends.
+ * This setting affects the size of the ptttl_sample_generator_t struct.
+ */
+#ifndef PTTTL_NOTE_PREFETCH_COUNT
+#define PTTTL_NOTE_PREFETCH_COUNT (4u)
+#endif // PTTTL_NOTE_PREFETCH_COUNT
+
+
+/**
+ * Maximum number of output channels (e.g. 2 for stereo) that samples can be generated
+ * for. Each PTTTL channel is mixed into every output channel with its own gain. This
+ * setting affects the size of the ptttl_sample_generator_t struct.
+ */
+#ifndef PTTTL_MAX_OUTPUT_CHANNELS
+#define PTTTL_MAX_OUTPUT_CHANNELS (2u)
+#endif // PTTTL_MAX_OUTPUT_CHANNELS
+
+
+/**
+ * Number of entries in the pitch tables of ptttl_sample_generator_t; one for each
+ * piano key note number (1 through 88), plus note number 0 for rests
+ */
+#define PTTTL_NOTE_PITCH_TABLE_SIZE (89u)
+
+
+/**
+ * Alignment in bytes of the arrays that hold per-sample voice state (see
+ * ptttl_voice_state_t). Each array starts on a multiple of this alignment, and is padded
+ * to a multiple of this size, so 64 (the cache line size of most CPUs, and the width of
+ * the widest common SIMD registers) keeps the state for up to 16 voices in a single
+ * cache line per array. Must be a power of 2, and at least 8.
+ */
+#ifndef PTTTL_VOICE_STATE_ALIGN
+#define PTTTL_VOICE_STATE_ALIGN (64u)
+#endif // PTTTL_VOICE_STATE_ALIGN
+
+
+/**
+ * Number of voices that are rendered together, one voice per SIMD lane, when several
+ * neighbouring channels are sounding at once. Should match the number of 32-bit floats
+ * in the SIMD registers of the target (e.g. 4 for SSE/NEON, 8 for AVX, 16 for AVX-512).
+ * The code is portable C, and relies on the compiler to vectorize it, so this is only
+ * faster when building with auto-vectorization enabled (e.g. -O3 for GCC); otherwise,
+ * leave it at 0, which renders each voice separately. Voice state arrays are padded to
+ * a multiple of this many voices. Must be 0, 4, 8 or 16.
+ */
+#ifndef PTTTL_VOICE_LANES
+#define PTTTL_VOICE_LANES (0u)
+#endif // PTTTL_VOICE_LANES
 
 
 /**
- * Represents the current note that samples are being generated for on any one channel
+ * Enumerates all supported output sample formats. Samples are always generated as
+ * floating point values internally, and converted directly to the output format.
+ */
+typedef enum
+{
+    PTTTL_SAMPLE_FORMAT_S16 = 0,  ///< Signed 16-bit integer samples (default)
+    PTTTL_SAMPLE_FORMAT_FLOAT32,  ///< 32-bit floating point samples, between -1.0 and 1.0
+    PTTTL_SAMPLE_FORMAT_S24,      ///< Signed 24-bit integer samples, packed little-endian in 3 bytes
+    PTTTL_SAMPLE_FORMAT_S8,       ///< Signed 8-bit integer samples
+    PTTTL_SAMPLE_FORMAT_U8,       ///< Unsigned 8-bit integer samples, with silence at 0x80
+    PTTTL_SAMPLE_FORMAT_COUNT
+} ptttl_sample_format_e;
+
+/**
+ * Represents the current note that samples are being generated for on any one channel.
+ * Only holds fields that are needed when a note starts or ends; state that is updated
+ * on every sample lives in ptttl_voice_state_t.
  */
 typedef struct
 {
+    uint64_t start_sample;        ///< The sample index on which this note started
     uint32_t vibrato_frequency;   ///< Vibrato frequency, in HZ
     uint32_t vibrato_variance;    ///< Vibrato variance, in HZ
-    unsigned int sine_index;      ///< Monotonically increasing index for sinf() function, note pitch
-    unsigned int start_sample;    ///< The sample index on which this note started
     unsigned int num_samples;     ///< Number of samples this note runs for
-    unsigned int attack;          ///< Note decay length, in samples
-    unsigned int decay;           ///< Note decay length, in samples
     unsigned int note_number;     ///< Piano key number for this note, 1-88
     float pitch_hz;               ///< Note pitch in Hz
-    float phasor_state;           ///< Phasor state for vibrato (frequency modulation)
+    const float *cached_samples;  ///< Samples for this note in the note cache, or NULL if not cached
+    uint32_t cached_position;     ///< Index of the next sample in cached_samples
+    uint32_t cache_slot;          ///< Note cache slot holding cached_samples
 } ptttl_note_stream_t;
 
+/**
+ * Per-sample state of all voices (one voice per channel), stored as a struct of arrays
+ * indexed by channel, so that generating a sample for a voice only touches the fields
+ * it needs, and the same field for neighbouring voices can be loaded into SIMD registers
+ * together. Each array has room for the channel count rounded up to a multiple of
+ * #PTTTL_VOICE_LANES (if set), and is aligned to, and padded to a multiple of,
+ * #PTTTL_VOICE_STATE_ALIGN bytes.
+ */
+typedef struct
+{
+    float *phasor;                ///< Oscillator phase in cycles (0.0 - 1.0), for notes with vibrato
+    float *pitch_hz;              ///< Note pitch in Hz, 0.0 for rests
+    float *vibrato_freq;          ///< Vibrato frequency, in Hz
+    float *vibrato_var;           ///< Vibrato variance, in Hz
+    uint32_t *sine_index;         ///< Index of the next sample within the note (0 is the first sample generated)
+    uint32_t *elapsed;            ///< No. of samples elapsed since the note started, for the next sample
+    uint32_t *length;             ///< Number of samples the note runs for
+    uint32_t *attack;             ///< Note attack length, in samples
+    uint32_t *decay;              ///< Note decay length, in samples
+} ptttl_voice_state_t;
+
+/**
+ * Ring of notes that have been parsed ahead of time for a single channel
+ */
+typedef struct
+{
+    ptttl_output_note_t notes[PTTTL_NOTE_PREFETCH_COUNT]; ///< Parsed notes, oldest first starting at 'head'
+    uint32_t head;                ///< Index of the next note to be loaded
+    uint32_t count;               ///< Number of parsed notes currently buffered
+    uint8_t parser_finished;      ///< 1 if the parser has no more notes for this channel
+    uint32_t next_event;          ///< Index of the next timeline event to be loaded, if notes come from a timeline
+    ptttl_parser_input_stream_t first_stream; ///< Parser input stream at the first note of this channel, for seeking
+} ptttl_note_prefetch_queue_t;
+
+/**
+ * A single note, compiled into everything the sample generator needs to start playing it
+ */
+typedef struct
+{
+    uint64_t start_sample;        ///< Sample on which the note is loaded (the last sample of the previous note)
+    uint32_t channel;             ///< Index of the PTTTL channel (voice) that plays the note
+    uint32_t note_settings;       ///< note_settings field of the parsed note (see ptttl_output_note_t)
+    uint32_t vibrato_settings;    ///< vibrato_settings field of the parsed note
+    uint32_t num_samples;         ///< Number of samples the note runs for
+    uint32_t attack;              ///< Note attack length in samples, shortened to fit the note
+    uint32_t decay;               ///< Note decay length in samples, shortened to fit the note
+    float pitch_hz;               ///< Note pitch in Hz, 0.0 for rests
+} ptttl_timeline_event_t;
+
+/**
+ * Every note of a PTTTL source text, compiled ahead of time into a flat array of events
+ * in caller-provided storage (see #ptttl_timeline_compile). Events are grouped by channel,
+ * and are in time order within each channel. A sample generator that plays notes from a
+ * timeline (see the timeline field of ptttl_sample_generator_config_t) does no parsing
+ * at all while generating samples, and samples generated from a timeline are identical
+ * to those that would have been generated by parsing.
+ *
+ * Events are only valid for the sample generator configuration they were compiled with;
+ * the sample rate, attack, decay and reference pitch must match. A timeline is never
+ * modified after it has been compiled, so it can be shared by any number of sample
+ * generators, including generators running on different threads.
+ */
+typedef struct
+{
+    ptttl_timeline_event_t *events; ///< All events, grouped by channel
+    uint32_t *channel_events;     ///< Index of the first event for each channel, plus the total event count
+    uint32_t event_count;         ///< Total number of events
+    uint32_t channel_count;       ///< Number of PTTTL channels
+    uint64_t total_samples;       ///< Total number of sample frames (see #ptttl_compute_total_samples)
+
+    // Configuration that events were compiled with
+    unsigned int sample_rate;
+    unsigned int attack_samples;
+    unsigned int decay_samples;
+    float reference_pitch_hz;
+} ptttl_timeline_t;
+
+/**
+ * Number of bytes of storage needed by a timeline for a given number of channels and
+ * events (see #ptttl_timeline_compile). Can be used to size static buffers at compile
+ * time. Includes room for aligning the start of the storage.
+ */
+#define PTTTL_TIMELINE_STORAGE_SIZE(channel_count, event_count)                   \
+    ((sizeof(uint64_t) - 1u) +                                                    \
+     ((size_t) (event_count) * sizeof(ptttl_timeline_event_t)) +                  \
+     (((size_t) (channel_count) + 1u) * sizeof(uint32_t)))
+
+/**
+ * A single slot of a note cache, holding the samples generated for one note
+ */
+typedef struct
+{
+    uint32_t note_settings;       ///< note_settings field of the cached note (see ptttl_output_note_t)
+    uint32_t vibrato_settings;    ///< vibrato_settings field of the cached note
+    uint32_t first_note;          ///< 1 if the note was cached as the first note on its channel
+    uint32_t sample_count;        ///< No. of samples cached, or 0 if this slot is empty
+    uint32_t pin_count;           ///< No. of channels currently playing samples from this slot
+    uint32_t last_used;           ///< Value of the cache use counter when this slot was last used
+} ptttl_note_cache_entry_t;
+
+/**
+ * Cache of the samples generated for recently played notes, in caller-provided storage.
+ * When a note is played that is already in the cache, its samples are copied from the
+ * cache instead of being generated again; this helps most with songs that repeat the
+ * same few notes many times, such as ringtones. When the cache is full, the least
+ * recently used slot that is not currently being played from is replaced. Notes are
+ * only cached if they fit in a single slot.
+ *
+ * Cached samples are only valid for the sample generator configuration they were
+ * generated with, so the cache is emptied when it is used by a sample generator with a
+ * different configuration. A note cache can only be used by one sample generator at a
+ * time. Samples played from the cache are identical to those that would have been
+ * generated without it.
+ */
+typedef struct
+{
+    ptttl_note_cache_entry_t *entries; ///< One entry per slot
+    float *samples;               ///< Cached samples, slot_samples for each slot
+    uint32_t slot_count;          ///< Number of slots
+    uint32_t slot_samples;        ///< Max. number of samples in a single slot
+    uint32_t use_counter;         ///< Incremented on every cache lookup, for finding the least recently used slot
+    uint32_t hits;                ///< No. of notes played from the cache
+    uint32_t misses;              ///< No. of notes that were not in the cache
+    uint32_t oversized;           ///< No. of misses for notes that were too long to be cached
+
+    // Configuration that cached samples were generated with
+    unsigned int sample_rate;
+    unsigned int attack_samples;
+    unsigned int decay_samples;
+    float amplitude;
+    float reference_pitch_hz;
+} ptttl_note_cache_t;
+
+/**
+ * State of a single block (';'-separated section of PTTTL source text) in a block cache
+ */
+typedef struct
+{
+    uint64_t note_fingerprint;    ///< Fingerprint of the notes parsed from the block, on all channels
+    uint64_t start_sample;        ///< Sample on which the last notes of the previous block end
+    uint64_t end_sample;          ///< Sample on which the last notes of this block end
+    size_t pcm_offset;            ///< Offset of this block's generated samples in the PCM storage, or SIZE_MAX
+    uint32_t source;              ///< Index of an identical earlier block to copy samples from, or UINT32_MAX
+    uint32_t channels_seen;       ///< No. of channels that have notes in this block
+    uint8_t aligned;              ///< 1 if all channels start and end this block on the same samples
+    uint8_t stored;               ///< 1 if all samples for this block have been stored in the PCM storage
+} ptttl_block_cache_entry_t;
+
+/**
+ * Cache of the samples generated for whole blocks of a single PTTTL source text, in
+ * caller-provided storage. Many songs repeat whole blocks verbatim (e.g. a chorus); when
+ * a block is repeated, the samples generated for its first occurrence are copied instead
+ * of being generated again, so generating a song takes time in proportion to the amount
+ * of unique content, rather than its total length.
+ *
+ * Blocks are matched by fingerprints of their text (see #ptttl_parse_block_fingerprints),
+ * confirmed by fingerprints of their parsed notes. Channels do not need to start or end a
+ * block at the same time, but only blocks that start and end on the same sample on every
+ * channel (i.e. no note on any channel crosses the start or end of the block) can be
+ * copied, since otherwise the samples for the block depend on its neighbours. The first
+ * block is never copied, since the first note on each channel runs for one extra sample.
+ *
+ * Samples are stored in the output format of the sample generator, so the PCM storage
+ * needed for a block is (frames in block * output channels * sample size) bytes. Blocks
+ * that do not fit in the remaining PCM storage are generated as normal every time. A
+ * block cache can only be used by one sample generator at a time, and samples copied
+ * from the cache are identical to those that would have been generated without it.
+ */
+typedef struct
+{
+    uint64_t *fingerprints;       ///< Text fingerprint of each block
+    ptttl_block_cache_entry_t *entries; ///< One entry per block
+    uint32_t block_count;         ///< Number of blocks in the PTTTL source text
+    uint8_t *pcm;                 ///< Storage for generated samples of repeated blocks
+    size_t pcm_size;              ///< Size of PCM storage in bytes
+    uint64_t copied_samples;      ///< No. of sample frames copied from the cache instead of being generated
+} ptttl_block_cache_t;
+
+/**
+ * Number of bytes of storage needed by a block cache for a given number of blocks, and
+ * a given number of bytes of PCM storage (see #ptttl_block_cache_init). Can be used to
+ * size static buffers at compile time. Includes room for aligning the start of the storage.
+ */
+#define PTTTL_BLOCK_CACHE_STORAGE_SIZE(block_count, pcm_size)                     \
+    ((sizeof(uint64_t) - 1u) +                                                    \
+     ((size_t) (block_count) * (sizeof(uint64_t) + sizeof(ptttl_block_cache_entry_t))) + \
+     (size_t) (pcm_size))
+
+/**
+ * Position of the first note that a single channel has in a single block, in a seek index
+ */
+typedef struct
+{
+    ptttl_parser_input_stream_t stream; ///< Input stream for the channel, before the note is parsed
+    uint64_t start_sample;        ///< Sample on which the note is loaded (see ptttl_timeline_event_t)
+} ptttl_seek_index_entry_t;
+
+/**
+ * Index of the position of every block (';'-separated section of PTTTL source text) on
+ * each channel, in caller-provided storage. The index is built by the first sample
+ * generator that is created with it (see the seek_index field of
+ * ptttl_sample_generator_config_t), which parses the whole input text once. After that,
+ * #ptttl_sample_generator_seek finds the block that is playing on each channel with a
+ * binary search, and only parses notes from the start of that block, so seeking takes
+ * time in proportion to the length of a block rather than the position in the song.
+ *
+ * The index only depends on the input text and the sampling rate, so it can be shared by
+ * any number of sample generators created with the same parser and sampling rate, e.g.
+ * to render several previews of the same song; it is built again if a generator is
+ * created with a different sampling rate. A seek index can only be built by one sample
+ * generator at a time.
+ */
+typedef struct
+{
+    ptttl_seek_index_entry_t *entries; ///< block_count entries for each channel, in time order
+    uint32_t *channel_entries;    ///< No. of entries used for each channel
+    uint32_t block_count;         ///< Number of blocks in the PTTTL source text
+    uint32_t channel_count;       ///< Number of PTTTL channels
+    uint64_t total_samples;       ///< Total number of sample frames (see #ptttl_compute_total_samples)
+    unsigned int sample_rate;     ///< Sampling rate that the index was built for, or 0 if not built yet
+} ptttl_seek_index_t;
+
+/**
+ * Number of bytes of storage needed by a seek index for a given number of channels and
+ * blocks (see #ptttl_seek_index_init). Can be used to size static buffers at compile
+ * time. Includes room for aligning the start of the storage.
+ */
+#define PTTTL_SEEK_INDEX_STORAGE_SIZE(channel_count, block_count)                 \
+    ((sizeof(uint64_t) - 1u) +                                                    \
+     ((size_t) (channel_count) * (size_t) (block_count) * sizeof(ptttl_seek_index_entry_t)) + \
+     ((size_t) (channel_count) * sizeof(uint32_t)))
+
+/**
+ * Number of bytes of storage needed by a note cache with a given number of slots, and
+ * a given number of samples per slot (see #ptttl_note_cache_init). Can be used to size
+ * static buffers at compile time. Includes room for aligning the start of the storage.
+ */
+#define PTTTL_NOTE_CACHE_STORAGE_SIZE(slot_count, slot_samples)                   \
+    ((sizeof(uint32_t) - 1u) +                                                    \
+     ((size_t) (slot_count) * (sizeof(ptttl_note_cache_entry_t) +                 \
+                               (sizeof(float) * (size_t) (slot_samples)))))
+
+// Round a voice state array size up to a multiple of PTTTL_VOICE_STATE_ALIGN bytes
+#define PTTTL_STORAGE_ALIGN(size) \
+    ((((size) + (PTTTL_VOICE_STATE_ALIGN - 1u)) / PTTTL_VOICE_STATE_ALIGN) * PTTTL_VOICE_STATE_ALIGN)
+
+// Round a channel count up to a multiple of PTTTL_VOICE_LANES
+#if PTTTL_VOICE_LANES > 0u
+#define PTTTL_VOICE_LANE_COUNT(channel_count) \
+    (((((size_t) (channel_count)) + (PTTTL_VOICE_LANES - 1u)) / PTTTL_VOICE_LANES) * PTTTL_VOICE_LANES)
+#else
+#define PTTTL_VOICE_LANE_COUNT(channel_count) ((size_t) (channel_count))
+#endif // PTTTL_VOICE_LANES > 0u
+
+// Size in bytes of a single ptttl_voice_state_t array, for a given channel count
+#define PTTTL_VOICE_ARRAY_SIZE(channel_count) \
+    PTTTL_STORAGE_ALIGN(sizeof(float) * PTTTL_VOICE_LANE_COUNT(channel_count))
+
+// Number of ptttl_voice_state_t arrays
+#define PTTTL_VOICE_STATE_ARRAY_COUNT (9u)
+
+/**
+ * Number of bytes of channel storage needed by the sample generator for a given number
+ * of channels (see the channel_storage field of ptttl_sample_generator_config_t). Can be
+ * used to size static buffers at compile time. Includes room for aligning the start of
+ * the storage to #PTTTL_VOICE_STATE_ALIGN bytes. Only the voice state arrays are padded;
+ * the other per-channel arrays are packed at their natural alignment.
+ */
+#define PTTTL_SAMPLE_GENERATOR_STORAGE_SIZE(channel_count)                                       \
+    ((PTTTL_VOICE_STATE_ALIGN - 1u) +                                                            \
+     (PTTTL_VOICE_ARRAY_SIZE(channel_count) * PTTTL_VOICE_STATE_ARRAY_COUNT) +                   \
+     ((size_t) (channel_count) * (sizeof(ptttl_note_stream_t) +                                  \
+                                  sizeof(ptttl_note_prefetch_queue_t) +                          \
+                                  (sizeof(float) * PTTTL_MAX_OUTPUT_CHANNELS) +                  \
+                                  (sizeof(uint32_t) * 2u) +                                      \
+                                  sizeof(uint8_t))))
+
 /**
  * Holds configurable parameters for sample generation
  */
@@ -58,18 +426,68 @@ typedef struct
     unsigned int attack_samples;  ///< no. of samples to ramp from 0 to full volume, at note start
     unsigned int decay_samples;   ///< no. of samples to ramp from full volume to 0, at note end
     float amplitude;              ///< Amplitude of generated samples between 0.0-1.0, with 1.0 being full volume
+    ptttl_sample_format_e sample_format; ///< Format of generated samples
+    unsigned int output_channels; ///< Number of output channels, 1 - #PTTTL_MAX_OUTPUT_CHANNELS (0 is treated as 1, mono)
+
+    /**
+     * Optional routing gains, describing how loud each PTTTL channel is in each output
+     * channel. Must hold (output_channels * number of PTTTL channels) gains, with all
+     * output channel gains for the first PTTTL channel first, followed by all output
+     * channel gains for the second PTTTL channel, and so on. Gains are copied when the
+     * generator is created, so this does not need to remain valid afterwards.
+     * If NULL, all PTTTL channels are mixed into all output channels with a gain of 1.0.
+     * See #ptttl_sample_generator_pan for a helper to calculate stereo panning gains.
+     */
+    const float *channel_gains;
+
+    /**
+     * Optional storage for the state of each PTTTL channel, with no alignment requirement.
+     * Must remain valid for as long as the generator is in use, and must be at least as
+     * large as #ptttl_sample_generator_storage_size reports for the number of PTTTL channels.
+     * If NULL, the storage built into ptttl_sample_generator_t is used, which has room
+     * for #PTTTL_MAX_CHANNELS_PER_FILE channels.
+     */
+    void *channel_storage;
+    size_t channel_storage_size;  ///< Size of channel_storage in bytes
+    float reference_pitch_hz;     ///< Pitch of A4 in Hz (normally 440.0), which all other pitches are tuned relative to. 0.0 is treated as 440.0
+    ptttl_note_cache_t *note_cache; ///< Optional initialized note cache (see #ptttl_note_cache_init), NULL to disable
+    ptttl_block_cache_t *block_cache; ///< Optional block cache initialized for the same parser (see #ptttl_block_cache_init), NULL to disable
+    const ptttl_timeline_t *timeline; ///< Optional timeline compiled from the same parser (see #ptttl_timeline_compile), NULL to parse notes while generating
+    ptttl_seek_index_t *seek_index; ///< Optional seek index initialized for the same parser (see #ptttl_seek_index_init), NULL to disable
 } ptttl_sample_generator_config_t;
 
 /**
- * Represents a sample generator instance created for a specific PTTTL/RTTTL source text
+ * Represents a sample generator instance created for a specific PTTTL/RTTTL source text.
+ *
+ * If no channel storage is provided in the configuration, the generator holds pointers
+ * into its own built-in channel storage, so it must not be copied or moved after
+ * #ptttl_sample_generator_create; a copy would share per-channel state with the original
+ * object. The parser object used to create the generator must not be moved either.
  */
 typedef struct
 {
-    unsigned int current_sample;
-    ptttl_note_stream_t note_streams[PTTTL_MAX_CHANNELS_PER_FILE];
-    uint8_t channel_finished[PTTTL_MAX_CHANNELS_PER_FILE];
+    uint64_t current_sample;
+    ptttl_voice_state_t voices;
+    ptttl_note_stream_t *note_streams;
+    uint8_t *channel_finished;
+    uint32_t *active_channels;    ///< Unfinished channels, in ascending order
+    uint32_t active_count;        ///< No. of entries in active_channels
+    uint32_t *sounding_channels;  ///< Active channels not currently resting
+    uint32_t sounding_count;      ///< No. of entries in sounding_channels
+    ptttl_note_prefetch_queue_t *prefetch_queues;
+    float (*channel_gains)[PTTTL_MAX_OUTPUT_CHANNELS];
+    float note_pitches[PTTTL_NOTE_PITCH_TABLE_SIZE]; ///< Pitch in Hz for each note number, 0.0 for rests
     ptttl_sample_generator_config_t config;
     ptttl_parser_t *parser;
+    uint32_t next_block;          ///< Index of the next block cache entry to check for a block start
+    uint32_t cache_block;         ///< Index of the block being copied or stored, if any
+    uint64_t copy_remaining;      ///< No. of sample frames left to copy from the block cache
+    uint64_t store_remaining;     ///< No. of generated sample frames left to store in the block cache
+    uint8_t *cache_pcm;           ///< Location of the next frame to copy or store in the block cache
+#if PTTTL_MAX_CHANNELS_PER_FILE > 0
+    /// Built-in channel storage, used if no channel storage is provided in the configuration
+    uint64_t channel_storage[(PTTTL_SAMPLE_GENERATOR_STORAGE_SIZE(PTTTL_MAX_CHANNELS_PER_FILE) + 7u) / sizeof(uint64_t)];
+#endif // PTTTL_MAX_CHANNELS_PER_FILE > 0
 } ptttl_sample_generator_t;
 
 
@@ -95,22 +513,315 @@ ptttl_parser_error_t ptttl_sample_generator_error(void);
 int ptttl_sample_generator_create(ptttl_parser_t *parser, ptttl_sample_generator_t *generator,
                                   ptttl_sample_generator_config_t *config);
 
+/**
+ * Return the number of bytes of channel storage needed by a sample generator for a
+ * given number of PTTTL channels (see the channel_storage field of
+ * ptttl_sample_generator_config_t). Use #ptttl_parse_count_channels to find out how
+ * many channels a given input text has.
+ *
+ * @param channel_count  Number of PTTTL channels
+ *
+ * @return Channel storage size in bytes
+ */
+size_t ptttl_sample_generator_storage_size(uint32_t channel_count);
+
+/**
+ * Initialize a note cache in caller-provided storage (see ptttl_note_cache_t). All hit,
+ * miss and oversized counters are set to 0. The cache can then be used by a sample
+ * generator, by setting the note_cache field of ptttl_sample_generator_config_t.
+ *
+ * A slot must hold every sample of a note to be able to cache it; for example, at 44.1kHz
+ * a quarter note at 100 beats per minute is 26460 samples. The hits, misses and oversized
+ * counters can be used to choose the number of slots and their size.
+ *
+ * @param cache          Pointer to note cache object to initialize
+ * @param storage        Pointer to storage with no alignment requirement, which must
+ *                       remain valid as long as the cache is in use
+ * @param storage_size   Size of storage in bytes, must be at least as large as
+ *                       #ptttl_note_cache_storage_size reports
+ * @param slot_count     Number of notes that can be cached at once, must not be 0
+ * @param slot_samples   Max. number of samples in a single cached note, must not be 0
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+int ptttl_note_cache_init(ptttl_note_cache_t *cache, void *storage, size_t storage_size,
+                          uint32_t slot_count, uint32_t slot_samples);
+
+/**
+ * Return the number of bytes of storage needed by a note cache with a given number of
+ * slots, and a given number of samples per slot
+ *
+ * @param slot_count     Number of notes that can be cached at once
+ * @param slot_samples   Max. number of samples in a single cached note
+ *
+ * @return Note cache storage size in bytes
+ */
+size_t ptttl_note_cache_storage_size(uint32_t slot_count, uint32_t slot_samples);
+
+/**
+ * Initialize a block cache in caller-provided storage (see ptttl_block_cache_t), for the
+ * PTTTL source text of an initialized parser. The text of every block is fingerprinted
+ * with #ptttl_parse_block_fingerprints, and the rest of the storage is used for storing
+ * generated samples. The cache can then be used by a sample generator created with the
+ * same parser, by setting the block_cache field of ptttl_sample_generator_config_t.
+ *
+ * @param cache          Pointer to block cache object to initialize
+ * @param parser         Pointer to initialized PTTTL parser object
+ * @param storage        Pointer to storage with no alignment requirement, which must
+ *                       remain valid as long as the cache is in use
+ * @param storage_size   Size of storage in bytes, must be at least as large as
+ *                       #ptttl_block_cache_storage_size reports for the number of blocks
+ *                       with no PCM storage; anything more is used for PCM storage
+ *
+ * @return 0 if successful, -1 if an error occurred. Call #ptttl_sample_generator_error
+ *         for an error description if -1 is returned.
+ */
+int ptttl_block_cache_init(ptttl_block_cache_t *cache, ptttl_parser_t *parser,
+                           void *storage, size_t storage_size);
+
+/**
+ * Return the number of bytes of storage needed by a block cache with a given number of
+ * blocks, and a given number of bytes of PCM storage. Use #ptttl_parse_block_fingerprints
+ * with NULL fingerprint storage to find out how many blocks a given input text has.
+ *
+ * @param block_count    Number of blocks in the PTTTL source text
+ * @param pcm_size       Number of bytes of PCM storage
+ *
+ * @return Block cache storage size in bytes
+ */
+size_t ptttl_block_cache_storage_size(uint32_t block_count, size_t pcm_size);
+
+/**
+ * Initialize a seek index in caller-provided storage (see ptttl_seek_index_t), for the
+ * PTTTL source text of an initialized parser. Only the blocks are counted here; the index
+ * is built by the first sample generator created with it, by setting the seek_index field
+ * of ptttl_sample_generator_config_t. The parser object is not modified.
+ *
+ * @param index          Pointer to seek index object to initialize
+ * @param parser         Pointer to initialized PTTTL parser object
+ * @param storage        Pointer to storage with no alignment requirement, which must
+ *                       remain valid as long as the index is in use
+ * @param storage_size   Size of storage in bytes, must be at least as large as
+ *                       #ptttl_seek_index_storage_size reports for the number of
+ *                       channels and blocks
+ *
+ * @return 0 if successful, -1 if an error occurred. Call #ptttl_sample_generator_error
+ *         for an error description if -1 is returned.
+ */
+int ptttl_seek_index_init(ptttl_seek_index_t *index, ptttl_parser_t *parser,
+                          void *storage, size_t storage_size);
+
+/**
+ * Return the number of bytes of storage needed by a seek index with a given number of
+ * channels and blocks. Use #ptttl_parse_block_fingerprints with NULL fingerprint storage
+ * to find out how many blocks a given input text has.
+ *
+ * @param channel_count  Number of PTTTL channels
+ * @param block_count    Number of blocks in the PTTTL source text
+ *
+ * @return Seek index storage size in bytes
+ */
+size_t ptttl_seek_index_storage_size(uint32_t channel_count, uint32_t block_count);
+
+/**
+ * Count the notes on all channels of a PTTTL source text, i.e. the number of events that
+ * #ptttl_timeline_compile will produce. The parser object is not modified.
+ *
+ * @param parser         Pointer to initialized PTTTL parser object
+ * @param event_count    Pointer to location to store the number of events
+ *
+ * @return 0 if successful, -1 if an error occurred. Call #ptttl_sample_generator_error
+ *         for an error description if -1 is returned.
+ */
+int ptttl_timeline_count_events(ptttl_parser_t *parser, uint32_t *event_count);
+
+/**
+ * Return the number of bytes of storage needed by a timeline with a given number of
+ * channels and events. Use #ptttl_timeline_count_events to find out how many events a
+ * given input text has.
+ *
+ * @param channel_count  Number of PTTTL channels
+ * @param event_count    Number of events
+ *
+ * @return Timeline storage size in bytes
+ */
+size_t ptttl_timeline_storage_size(uint32_t channel_count, uint32_t event_count);
+
+/**
+ * Compile every note of a PTTTL source text into a timeline (see ptttl_timeline_t) in
+ * caller-provided storage, for a given sample generator configuration. Once compiled,
+ * samples can be generated from the timeline by setting the timeline field of
+ * ptttl_sample_generator_config_t, and creating a sample generator with the same parser.
+ *
+ * The parser object is not modified, so it can still be used to create a sample
+ * generator afterwards.
+ *
+ * @param parser         Pointer to initialized PTTTL parser object
+ * @param config         Pointer to sample generator configuration data
+ * @param timeline       Pointer to timeline object to initialize
+ * @param storage        Pointer to storage with no alignment requirement, which must
+ *                       remain valid as long as the timeline is in use
+ * @param storage_size   Size of storage in bytes, must be at least as large as
+ *                       #ptttl_timeline_storage_size reports
+ *
+ * @return 0 if successful, -1 if an error occurred. Call #ptttl_sample_generator_error
+ *         for an error description if -1 is returned.
+ */
+int ptttl_timeline_compile(ptttl_parser_t *parser, ptttl_sample_generator_config_t *config,
+                           ptttl_timeline_t *timeline, void *storage, size_t storage_size);
+
+/**
+ * Calculate equal-power stereo panning gains for a single PTTTL channel, suitable for
+ * the 'channel_gains' field of ptttl_sample_generator_config_t with 2 output channels
+ *
+ * @param pan     Pan position between -1.0 (fully left) and 1.0 (fully right), with
+ *                0.0 being centered. Values outside this range are clamped.
+ * @param gains   Pointer to location to store left and right channel gains, in that order
+ */
+void ptttl_sample_generator_pan(float pan, float *gains);
+
+/**
+ * Get the size of a single sample in the given sample format
+ *
+ * @param format   Sample format
+ *
+ * @return Size of a single sample in bytes, or 0 if the sample format is invalid
+ */
+unsigned int ptttl_sample_format_size(ptttl_sample_format_e format);
+
+/**
+ * Calculate the exact number of sample frames that a sample generator created with the
+ * given parser and configuration would produce, without generating any samples. Only note
+ * durations are parsed, so this is much faster than generating all samples. This is
+ * useful when the total length must be known before any samples are generated, for
+ * example to write a WAV file header before the sample data.
+ *
+ * The parser object is not modified, so it can still be used to create a sample
+ * generator afterwards.
+ *
+ * @param parser         Pointer to initialized PTTTL parser object
+ * @param config         Pointer to sample generator configuration data
+ * @param total_samples  Pointer to location to store total number of sample frames
+ *
+ * @return 0 if successful, -1 if an error occurred. Call #ptttl_sample_generator_error
+ *         for an error description if -1 is returned.
+ */
+int ptttl_compute_total_samples(ptttl_parser_t *parser, ptttl_sample_generator_config_t *config,
+                                uint64_t *total_samples);
+
+/**
+ * Parse upcoming notes for all channels ahead of time, until the prefetch buffer for
+ * each channel is full (see #PTTTL_NOTE_PREFETCH_COUNT) or no more notes remain.
+ *
+ * This is called automatically at the start of #ptttl_sample_generator_generate, so
+ * calling it yourself is optional, and #ptttl_sample_generator_generate parses up to
+ * #PTTTL_NOTE_PREFETCH_COUNT notes per channel whenever it is called. The per-sample
+ * path never calls the parser; if the buffer for a channel runs dry partway
+ * through a call, a single note is parsed for that channel at the sample where its
+ * current note ends.
+ *
+ * If you are generating samples from a time-critical context (e.g. an interrupt
+ * handler), use #ptttl_sample_generator_generate_no_parse (or
+ * #ptttl_sample_generator_generate_prefetched) there instead, and call this function
+ * from a less time-critical context often enough that the buffers do not run dry. The
+ * two must not run at the same time.
+ *
+ * @param generator        Pointer to initialized generator object
+ *
+ * @return 0 if successful, and -1 if an error occurred. Call #ptttl_sample_generator_error
+ *         for an error description if -1 is returned.
+ */
+int ptttl_sample_generator_prefetch(ptttl_sample_generator_t *generator);
+
+/**
+ * Move an initialized generator to an arbitrary sample, so that the next sample generated
+ * is the one at the given index, without generating any of the samples before it.
+ *
+ * If the generator plays notes from a timeline (see #ptttl_timeline_compile), the note
+ * playing on each channel is found with a binary search of the channel's events, so
+ * seeking takes time in proportion to the log of the number of notes. Otherwise, each
+ * channel is parsed again reading only note durations, starting from the block that is
+ * playing if the generator has a seek index (see #ptttl_seek_index_init), or from the
+ * first note of the channel if not. Samples
+ * generated after seeking are identical to those that would have been generated without
+ * seeking; for a note that is partway through at the new position, notes with vibrato
+ * have their oscillator phase advanced through each of the samples that are skipped.
+ *
+ * @param generator        Pointer to initialized generator object
+ * @param sample_index     Index of the next sample frame to generate. If this is past the
+ *                         end of the song, the next call to #ptttl_sample_generator_generate
+ *                         reports that all samples have been generated.
+ *
+ * @return 0 if successful, and -1 if an error occurred. Call #ptttl_sample_generator_error
+ *         for an error description if -1 is returned.
+ */
+int ptttl_sample_generator_seek(ptttl_sample_generator_t *generator, uint64_t sample_index);
+
 /**
  * Generate the next audio sample(s) for an initialized generator object
  *
  * @param generator        Pointer to initialized generator object
- * @param num_samples      Pointer to number of samples to generate. If successful,
- *                         then this pointer is re-used to write out the actual number
- *                         of samples generated.
- * @param samples          Pointer to location to store sample values. The caller is
- *                         expected to provide at least (sizeof(int16_t) * num_samples)
- *                         bytes of storage for the generated samples.
+ * @param num_samples      Pointer to number of sample frames to generate (one frame holds
+ *                         one sample for each output channel). If successful, then this
+ *                         pointer is re-used to write out the actual number of sample
+ *                         frames generated.
+ * @param samples          Pointer to location to store sample values, in the sample format
+ *                         selected in the generator configuration. Frames are interleaved,
+ *                         i.e. the samples for all output channels of the first frame come
+ *                         first, followed by all samples for the second frame, and so on.
+ *                         The caller is expected to provide at least
+ *                         (ptttl_sample_format_size(format) * output_channels * num_samples)
+ *                         bytes of storage for the generated samples, suitably aligned for
+ *                         the sample format.
  *
  * @return 0 if successful, 1 if all samples have been generated, and -1 if an error occurred.
  *         Call #ptttl_sample_generator_error for an error description if -1 is returned.
  */
 int ptttl_sample_generator_generate(ptttl_sample_generator_t *generator,
-                                    uint32_t *num_samples, int16_t *samples);
+                                    uint32_t *num_samples, void *samples);
+
+/**
+ * Same as #ptttl_sample_generator_generate, but without calling
+ * #ptttl_sample_generator_prefetch first, so that only notes that have already been
+ * parsed are used. The parser is only called if the prefetch buffer for a channel runs
+ * dry, and then only for the one note that is needed where the current note ends.
+ *
+ * @param generator        Pointer to initialized generator object
+ * @param num_samples      Pointer to number of sample frames to generate, see
+ *                         #ptttl_sample_generator_generate
+ * @param samples          Pointer to location to store sample values, see
+ *                         #ptttl_sample_generator_generate
+ *
+ * @return 0 if successful, 1 if all samples have been generated, and -1 if an error occurred.
+ *         Call #ptttl_sample_generator_error for an error description if -1 is returned.
+ */
+int ptttl_sample_generator_generate_prefetched(ptttl_sample_generator_t *generator,
+                                               uint32_t *num_samples, void *samples);
+
+/**
+ * Same as #ptttl_sample_generator_generate_prefetched, but never calls the parser, so
+ * that it is safe to call from contexts where the parser input interface must not be
+ * used (e.g. an interrupt handler, while the input is read from a file). If the prefetch
+ * buffer for a channel runs dry, generation stops before the sample where the channel
+ * needs its next note, and 2 is returned; the generator is left in a consistent state,
+ * so generation continues from that sample once #ptttl_sample_generator_prefetch has
+ * been called. Blocks are only copied from the block cache (see #ptttl_block_cache_init)
+ * if the generator has a timeline, since skipping the notes of a copied block otherwise
+ * needs the parser; other repeated blocks are generated as normal.
+ *
+ * @param generator        Pointer to initialized generator object
+ * @param num_samples      Pointer to number of sample frames to generate, see
+ *                         #ptttl_sample_generator_generate
+ * @param samples          Pointer to location to store sample values, see
+ *                         #ptttl_sample_generator_generate
+ *
+ * @return 0 if successful, 1 if all samples have been generated, 2 if generation stopped
+ *         early because the prefetch buffer for a channel ran dry, and -1 if an error
+ *         occurred. Call #ptttl_sample_generator_error for an error description if -1
+ *         is returned.
+ */
+int ptttl_sample_generator_generate_no_parse(ptttl_sample_generator_t *generator,
+                                             uint32_t *num_samples, void *samples);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,875 @@
+/* ptttl_to_flac.c
+ *
+ * Converts the output of ptttl_parse() into a FLAC file (lossless compression).
+ * No dynamic memory allocation, and no loading the entire FLAC file in memory.
+ *
+ * Requires ptttl_parser.c, ptttl_sample_generator.c and ptttl_output_sink.c
+ *
+ * Requires stdint.h, and fopen/fwrite from stdio.h
+ *
+ * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
+ *
+ * Erik Nyquist 2025
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ptttl_to_flac.h"
+
+
+#if (PTTTL_FLAC_BLOCK_SIZE < 16u) || (PTTTL_FLAC_BLOCK_SIZE > 65535u)
+#error "PTTTL_FLAC_BLOCK_SIZE must be between 16 and 65535"
+#endif
+
+#if (PTTTL_FLAC_OUTPUT_BUFFER_SIZE < 32u)
+#error "PTTTL_FLAC_OUTPUT_BUFFER_SIZE must be at least 32"
+#endif
+
+#if (PTTTL_FLAC_MAX_PARTITION_ORDER > 15u)
+#error "PTTTL_FLAC_MAX_PARTITION_ORDER must be between 0 and 15"
+#endif
+
+
+// Sample width in bits
+#define BITS_PER_SAMPLE (16u)
+
+// Maximum number of channels in a FLAC stream
+#define FLAC_MAX_CHANNELS (8u)
+
+// Size of the 'fLaC' marker, STREAMINFO metadata block header and STREAMINFO metadata block
+#define FLAC_STREAM_HEADER_SIZE (4u + 4u + 34u)
+
+// Size of the STREAMINFO metadata block
+#define FLAC_STREAMINFO_SIZE (34u)
+
+// Largest possible size of a frame header, in bytes
+#define FLAC_MAX_FRAME_HEADER_SIZE (16u)
+
+// Sync code and fixed-blocksize flag at the start of each frame header
+#define FLAC_FRAME_SYNC_CODE (0xfff8u)
+
+// Frame header block size code indicating that (block size - 1) follows the frame number, as 16 bits
+#define FLAC_BLOCK_SIZE_CODE_16BIT (0x7u)
+
+// Frame header sample rate code indicating that the sample rate is stored in STREAMINFO
+#define FLAC_SAMPLE_RATE_CODE_STREAMINFO (0x0u)
+
+// Frame header sample size code for 16-bit samples
+#define FLAC_SAMPLE_SIZE_CODE_16BIT (0x4u)
+
+// Subframe type codes
+#define FLAC_SUBFRAME_CONSTANT (0x00u)
+#define FLAC_SUBFRAME_VERBATIM (0x01u)
+#define FLAC_SUBFRAME_FIXED    (0x08u)
+
+// Highest order of the fixed linear predictors
+#define FLAC_MAX_FIXED_ORDER (4u)
+
+// Largest Rice parameter that can be used with 4-bit parameters (15 is the escape code)
+#define FLAC_MAX_RICE_PARAM (14u)
+
+// Largest total sample count that can be stored in STREAMINFO (36 bits)
+#define FLAC_MAX_TOTAL_SAMPLES (0xFFFFFFFFFull)
+
+
+// MD5 per-round constants
+static const uint32_t _md5_k[64] =
+{
+    0xd76aa478u, 0xe8c7b756u, 0x242070dbu, 0xc1bdceeeu,
+    0xf57c0fafu, 0x4787c62au, 0xa8304613u, 0xfd469501u,
+    0x698098d8u, 0x8b44f7afu, 0xffff5bb1u, 0x895cd7beu,
+    0x6b901122u, 0xfd987193u, 0xa679438eu, 0x49b40821u,
+    0xf61e2562u, 0xc040b340u, 0x265e5a51u, 0xe9b6c7aau,
+    0xd62f105du, 0x02441453u, 0xd8a1e681u, 0xe7d3fbc8u,
+    0x21e1cde6u, 0xc33707d6u, 0xf4d50d87u, 0x455a14edu,
+    0xa9e3e905u, 0xfcefa3f8u, 0x676f02d9u, 0x8d2a4c8au,
+    0xfffa3942u, 0x8771f681u, 0x6d9d6122u, 0xfde5380cu,
+    0xa4beea44u, 0x4bdecfa9u, 0xf6bb4b60u, 0xbebfbc70u,
+    0x289b7ec6u, 0xeaa127fau, 0xd4ef3085u, 0x04881d05u,
+    0xd9d4d039u, 0xe6db99e5u, 0x1fa27cf8u, 0xc4ac5665u,
+    0xf4292244u, 0x432aff97u, 0xab9423a7u, 0xfc93a039u,
+    0x655b59c3u, 0x8f0ccc92u, 0xffeff47du, 0x85845dd1u,
+    0x6fa87e4fu, 0xfe2ce6e0u, 0xa3014314u, 0x4e0811a1u,
+    0xf7537e82u, 0xbd3af235u, 0x2ad7d2bbu, 0xeb86d391u
+};
+
+// MD5 per-round left rotation amounts
+static const uint8_t _md5_shift[64] =
+{
+    7u, 12u, 17u, 22u, 7u, 12u, 17u, 22u, 7u, 12u, 17u, 22u, 7u, 12u, 17u, 22u,
+    5u, 9u, 14u, 20u, 5u, 9u, 14u, 20u, 5u, 9u, 14u, 20u, 5u, 9u, 14u, 20u,
+    4u, 11u, 16u, 23u, 4u, 11u, 16u, 23u, 4u, 11u, 16u, 23u, 4u, 11u, 16u, 23u,
+    6u, 10u, 15u, 21u, 6u, 10u, 15u, 21u, 6u, 10u, 15u, 21u, 6u, 10u, 15u, 21u
+};
+
+
+/* The MD5 signature in STREAMINFO is the MD5 digest (RFC 1321) of all samples, as
+ * interleaved little-endian 16-bit values. */
+
+// Initialize MD5 digest state
+static void _md5_init(ptttl_flac_encoder_t *encoder)
+{
+    encoder->md5_state[0] = 0x67452301u;
+    encoder->md5_state[1] = 0xefcdab89u;
+    encoder->md5_state[2] = 0x98badcfeu;
+    encoder->md5_state[3] = 0x10325476u;
+    encoder->md5_length = 0u;
+}
+
+// Add one complete 64-byte block to the MD5 digest state
+static void _md5_transform(ptttl_flac_encoder_t *encoder)
+{
+    uint32_t words[16];
+    for (uint32_t i = 0u; i < 16u; i++)
+    {
+        const uint8_t *src = &encoder->md5_block[i * 4u];
+        words[i] = ((uint32_t) src[0]) | (((uint32_t) src[1]) << 8u) |
+                   (((uint32_t) src[2]) << 16u) | (((uint32_t) src[3]) << 24u);
+    }
+
+    uint32_t a = encoder->md5_state[0];
+    uint32_t b = encoder->md5_state[1];
+    uint32_t c = encoder->md5_state[2];
+    uint32_t d = encoder->md5_state[3];
+
+    for (uint32_t i = 0u; i < 64u; i++)
+    {
+        uint32_t f;
+        uint32_t g;
+
+        if (i < 16u)
+        {
+            f = (b & c) | (~b & d);
+            g = i;
+        }
+        else if (i < 32u)
+        {
+            f = (d & b) | (~d & c);
+            g = ((5u * i) + 1u) % 16u;
+        }
+        else if (i < 48u)
+        {
+            f = b ^ c ^ d;
+            g = ((3u * i) + 5u) % 16u;
+        }
+        else
+        {
+            f = c ^ (b | ~d);
+            g = (7u * i) % 16u;
+        }
+
+        uint32_t sum = a + f + _md5_k[i] + words[g];
+        a = d;
+        d = c;
+        c = b;
+        b += (sum << _md5_shift[i]) | (sum >> (32u - _md5_shift[i]));
+    }
+
+    encoder->md5_state[0] += a;
+    encoder->md5_state[1] += b;
+    encoder->md5_state[2] += c;
+    encoder->md5_state[3] += d;
+}
+
+// Add a single byte to the MD5 digest
+static void _md5_add_byte(ptttl_flac_encoder_t *encoder, uint8_t value)
+{
+    encoder->md5_block[encoder->md5_length % 64u] = value;
+    encoder->md5_length += 1u;
+
+    if (0u == (encoder->md5_length % 64u))
+    {
+        _md5_transform(encoder);
+    }
+}
+
+// Finish the MD5 digest, and write the 16-byte signature to 'digest'
+static void _md5_finish(ptttl_flac_encoder_t *encoder, uint8_t *digest)
+{
+    uint64_t length_bits = encoder->md5_length * 8u;
+
+    _md5_add_byte(encoder, 0x80u);
+    while (56u != (encoder->md5_length % 64u))
+    {
+        _md5_add_byte(encoder, 0u);
+    }
+
+    for (uint32_t i = 0u; i < 8u; i++)
+    {
+        _md5_add_byte(encoder, (uint8_t) ((length_bits >> (i * 8u)) & 0xffu));
+    }
+
+    for (uint32_t i = 0u; i < 16u; i++)
+    {
+        digest[i] = (uint8_t) ((encoder->md5_state[i / 4u] >> ((i % 4u) * 8u)) & 0xffu);
+    }
+}
+
+
+/* Encoded data is written MSB-first, one bit field at a time, into a small output
+ * buffer which is written to the sink whenever it fills up. The CRC-16 of the current
+ * frame is updated as each byte is completed. */
+
+// Write the contents of the output buffer to the sink
+static void _flush_output(ptttl_flac_encoder_t *encoder)
+{
+    if ((0u < encoder->output_len) && (0 == encoder->error))
+    {
+        if (0 != encoder->sink->write(encoder->sink->context, encoder->output, encoder->output_len))
+        {
+            encoder->error = -1;
+        }
+    }
+
+    encoder->output_len = 0u;
+}
+
+// Write a single completed byte to the output buffer
+static void _put_byte(ptttl_flac_encoder_t *encoder, uint8_t value)
+{
+    // CRC-16, polynomial x^16 + x^15 + x^2 + 1
+    encoder->crc16 ^= (uint16_t) (((uint16_t) value) << 8u);
+    for (uint32_t i = 0u; i < 8u; i++)
+    {
+        encoder->crc16 = (uint16_t) ((0u != (encoder->crc16 & 0x8000u)) ?
+                                     (((unsigned int) encoder->crc16 << 1u) ^ 0x8005u) :
+                                     ((unsigned int) encoder->crc16 << 1u));
+    }
+
+    encoder->output[encoder->output_len] = value;
+    encoder->output_len += 1u;
+    encoder->bytes_written += 1u;
+
+    if (PTTTL_FLAC_OUTPUT_BUFFER_SIZE == encoder->output_len)
+    {
+        _flush_output(encoder);
+    }
+}
+
+// Write the lowest 'num_bits' bits of 'value' (up to 32 bits)
+static void _put_bits(ptttl_flac_encoder_t *encoder, uint32_t value, uint32_t num_bits)
+{
+    uint64_t mask = (((uint64_t) 1u) << num_bits) - 1u;
+
+    encoder->bit_buffer = (encoder->bit_buffer << num_bits) | (((uint64_t) value) & mask);
+    encoder->bit_count += num_bits;
+
+    while (encoder->bit_count >= 8u)
+    {
+        encoder->bit_count -= 8u;
+        _put_byte(encoder, (uint8_t) ((encoder->bit_buffer >> encoder->bit_count) & 0xffu));
+    }
+
+    encoder->bit_buffer &= (((uint64_t) 1u) << encoder->bit_count) - 1u;
+}
+
+// Write a Rice-coded residual value, with Rice parameter 'param'
+static void _put_rice(ptttl_flac_encoder_t *encoder, int32_t residual, uint32_t param)
+{
+    // Fold signed residual into an unsigned value: 0, -1, 1, -2, 2 ... becomes 0, 1, 2, 3, 4 ...
+    uint32_t folded = (residual < 0) ? ((((uint32_t) -residual) << 1u) - 1u) : (((uint32_t) residual) << 1u);
+    uint32_t quotient = folded >> param;
+    uint32_t remainder = folded & ((1u << param) - 1u);
+
+    // Quotient in unary (zeros, terminated by a 1), followed by remainder in binary
+    if ((quotient + 1u + param) <= 32u)
+    {
+        _put_bits(encoder, (1u << param) | remainder, quotient + 1u + param);
+    }
+    else
+    {
+        while (quotient >= 32u)
+        {
+            _put_bits(encoder, 0u, 32u);
+            quotient -= 32u;
+        }
+
+        _put_bits(encoder, 0u, quotient);
+        _put_bits(encoder, 1u, 1u);
+        _put_bits(encoder, remainder, param);
+    }
+}
+
+
+/**
+ * Calculate the residual of one of the fixed linear predictors, for a single sample
+ *
+ * @param samples  Pointer to interleaved samples for the current block, starting at
+ *                 the first sample of the channel being encoded
+ * @param stride   Number of interleaved channels
+ * @param index    Index of sample within the block, must be at least 'order'
+ * @param order    Predictor order, 0-4
+ *
+ * @return Residual (difference between the sample and the predicted sample)
+ */
+static int32_t _fixed_residual(const int16_t *samples, uint32_t stride, uint32_t index, uint32_t order)
+{
+    int32_t x0 = samples[index * stride];
+
+    switch (order)
+    {
+        case 0u:
+            return x0;
+        case 1u:
+            return x0 - samples[(index - 1u) * stride];
+        case 2u:
+            return x0 - (2 * samples[(index - 1u) * stride]) + samples[(index - 2u) * stride];
+        case 3u:
+            return x0 - (3 * samples[(index - 1u) * stride]) + (3 * samples[(index - 2u) * stride])
+                   - samples[(index - 3u) * stride];
+        default:
+            return x0 - (4 * samples[(index - 1u) * stride]) + (6 * samples[(index - 2u) * stride])
+                   - (4 * samples[(index - 3u) * stride]) + samples[(index - 4u) * stride];
+    }
+}
+
+/**
+ * Estimate the best Rice parameter for a partition of residuals
+ *
+ * @param folded_sum  Sum of all residuals in the partition, folded to unsigned values
+ * @param count       Number of residuals in the partition
+ *
+ * @return Rice parameter
+ */
+static uint32_t _rice_param(uint64_t folded_sum, uint32_t count)
+{
+    uint32_t param = 0u;
+    while ((param < FLAC_MAX_RICE_PARAM) && ((((uint64_t) count) << (param + 1u)) < folded_sum))
+    {
+        param += 1u;
+    }
+
+    return param;
+}
+
+/**
+ * Choose the Rice partition order and per-partition Rice parameters for the residuals
+ * of a fixed predictor, and estimate the encoded size of the residuals. The chosen
+ * parameters are stored in encoder->partition_params.
+ *
+ * @param encoder      Pointer to encoder state
+ * @param samples      Pointer to first sample of the channel being encoded
+ * @param stride       Number of interleaved channels
+ * @param block_size   Number of samples in the block
+ * @param order        Predictor order
+ * @param bits         Pointer to location to store estimated encoded size in bits
+ *
+ * @return Chosen partition order
+ */
+static uint32_t _choose_partitions(ptttl_flac_encoder_t *encoder, const int16_t *samples, uint32_t stride,
+                                   uint32_t block_size, uint32_t order, uint64_t *bits)
+{
+    // Every partition must contain the same number of samples, and more samples than the predictor order
+    uint32_t max_partition_order = PTTTL_FLAC_MAX_PARTITION_ORDER;
+    while ((0u < max_partition_order) && ((0u != (block_size % (1u << max_partition_order))) ||
+                                          ((block_size >> max_partition_order) <= order)))
+    {
+        max_partition_order -= 1u;
+    }
+
+    // Sum folded residuals for each partition at the highest partition order
+    uint64_t sums[1u << PTTTL_FLAC_MAX_PARTITION_ORDER];
+    uint32_t partition_size = block_size >> max_partition_order;
+
+    for (uint32_t part = 0u; part < (1u << max_partition_order); part++)
+    {
+        sums[part] = 0u;
+        uint32_t start = (0u == part) ? order : (part * partition_size);
+
+        for (uint32_t i = start; i < ((part + 1u) * partition_size); i++)
+        {
+            int32_t residual = _fixed_residual(samples, stride, i, order);
+            sums[part] += (residual < 0) ? ((((uint64_t) -residual) << 1u) - 1u) : (((uint64_t) residual) << 1u);
+        }
+    }
+
+    // Try each partition order, merging pairs of partitions to go down each order
+    uint8_t params[1u << PTTTL_FLAC_MAX_PARTITION_ORDER];
+    uint64_t best_bits = UINT64_MAX;
+    uint32_t best_order = 0u;
+
+    for (uint32_t partition_order = max_partition_order; ; partition_order--)
+    {
+        uint32_t num_partitions = 1u << partition_order;
+        uint64_t total_bits = 0u;
+
+        for (uint32_t part = 0u; part < num_partitions; part++)
+        {
+            uint32_t count = (block_size >> partition_order) - ((0u == part) ? order : 0u);
+            uint32_t param = _rice_param(sums[part], count);
+            params[part] = (uint8_t) param;
+            total_bits += 4u + (((uint64_t) count) * (param + 1u)) + (sums[part] >> param);
+        }
+
+        if (total_bits < best_bits)
+        {
+            best_bits = total_bits;
+            best_order = partition_order;
+            for (uint32_t part = 0u; part < num_partitions; part++)
+            {
+                encoder->partition_params[part] = params[part];
+            }
+        }
+
+        if (0u == partition_order)
+        {
+            break;
+        }
+
+        for (uint32_t part = 0u; part < (num_partitions / 2u); part++)
+        {
+            sums[part] = sums[part * 2u] + sums[(part * 2u) + 1u];
+        }
+    }
+
+    *bits = best_bits;
+    return best_order;
+}
+
+/**
+ * Encode a single channel of the current block as a FLAC subframe
+ *
+ * @param encoder      Pointer to encoder state
+ * @param channel      Channel number
+ * @param channels     Number of interleaved channels
+ * @param block_size   Number of samples in the block
+ */
+static void _encode_subframe(ptttl_flac_encoder_t *encoder, uint32_t channel, uint32_t channels,
+                             uint32_t block_size)
+{
+    const int16_t *samples = &encoder->samples[channel];
+
+    // Use a CONSTANT subframe if all samples are the same (e.g. during rests)
+    uint32_t i = 1u;
+    while ((i < block_size) && (samples[i * channels] == samples[0]))
+    {
+        i += 1u;
+    }
+
+    if (i == block_size)
+    {
+        _put_bits(encoder, FLAC_SUBFRAME_CONSTANT << 1u, 8u);
+        _put_bits(encoder, (uint16_t) samples[0], BITS_PER_SAMPLE);
+        return;
+    }
+
+    // Choose the fixed predictor order with the smallest total residual
+    uint32_t order = FLAC_MAX_FIXED_ORDER + 1u;
+    uint64_t bits = UINT64_MAX;
+    uint32_t partition_order = 0u;
+
+    if (block_size > FLAC_MAX_FIXED_ORDER)
+    {
+        uint64_t error_sums[FLAC_MAX_FIXED_ORDER + 1u] = {0u};
+        for (i = FLAC_MAX_FIXED_ORDER; i < block_size; i++)
+        {
+            for (uint32_t j = 0u; j <= FLAC_MAX_FIXED_ORDER; j++)
+            {
+                int32_t residual = _fixed_residual(samples, channels, i, j);
+                error_sums[j] += (uint64_t) ((residual < 0) ? -residual : residual);
+            }
+        }
+
+        order = 0u;
+        for (uint32_t j = 1u; j <= FLAC_MAX_FIXED_ORDER; j++)
+        {
+            if (error_sums[j] < error_sums[order])
+            {
+                order = j;
+            }
+        }
+
+        partition_order = _choose_partitions(encoder, samples, channels, block_size, order, &bits);
+        bits += 6u + (order * BITS_PER_SAMPLE);
+    }
+
+    // Fall back to VERBATIM if prediction does not help
+    if (bits >= (((uint64_t) block_size) * BITS_PER_SAMPLE))
+    {
+        _put_bits(encoder, FLAC_SUBFRAME_VERBATIM << 1u, 8u);
+        for (i = 0u; i < block_size; i++)
+        {
+            _put_bits(encoder, (uint16_t) samples[i * channels], BITS_PER_SAMPLE);
+        }
+
+        return;
+    }
+
+    _put_bits(encoder, (FLAC_SUBFRAME_FIXED | order) << 1u, 8u);
+
+    // Warm-up samples
+    for (i = 0u; i < order; i++)
+    {
+        _put_bits(encoder, (uint16_t) samples[i * channels], BITS_PER_SAMPLE);
+    }
+
+    // Residual coding method 0 (4-bit Rice parameters), and partition order
+    _put_bits(encoder, 0u, 2u);
+    _put_bits(encoder, partition_order, 4u);
+
+    uint32_t partition_size = block_size >> partition_order;
+    for (uint32_t part = 0u; part < (1u << partition_order); part++)
+    {
+        uint32_t param = encoder->partition_params[part];
+        _put_bits(encoder, param, 4u);
+
+        uint32_t start = (0u == part) ? order : (part * partition_size);
+        for (i = start; i < ((part + 1u) * partition_size); i++)
+        {
+            _put_rice(encoder, _fixed_residual(samples, channels, i, order), param);
+        }
+    }
+}
+
+/**
+ * Encode the current block as a single FLAC frame
+ *
+ * @param encoder       Pointer to encoder state
+ * @param channels      Number of interleaved channels
+ * @param block_size    Number of samples in the block
+ * @param frame_number  Frame number, starting at 0
+ */
+static void _encode_frame(ptttl_flac_encoder_t *encoder, uint32_t channels, uint32_t block_size,
+                          uint32_t frame_number)
+{
+    // Make sure the frame header is contiguous in the output buffer, for the CRC-8
+    if ((PTTTL_FLAC_OUTPUT_BUFFER_SIZE - encoder->output_len) < FLAC_MAX_FRAME_HEADER_SIZE)
+    {
+        _flush_output(encoder);
+    }
+
+    uint64_t frame_start = encoder->bytes_written;
+    uint32_t header_start = encoder->output_len;
+    encoder->crc16 = 0u;
+
+    _put_bits(encoder, FLAC_FRAME_SYNC_CODE, 16u);
+    _put_bits(encoder, FLAC_BLOCK_SIZE_CODE_16BIT, 4u);
+    _put_bits(encoder, FLAC_SAMPLE_RATE_CODE_STREAMINFO, 4u);
+    _put_bits(encoder, channels - 1u, 4u);    // Independent channels
+    _put_bits(encoder, FLAC_SAMPLE_SIZE_CODE_16BIT, 3u);
+    _put_bits(encoder, 0u, 1u);
+
+    // Frame number, in the same variable-length coding as UTF-8
+    if (frame_number < 0x80u)
+    {
+        _put_bits(encoder, frame_number, 8u);
+    }
+    else
+    {
+        uint32_t extra_bytes = 1u;
+        while ((extra_bytes < 5u) && (frame_number >= (1u << ((5u * (extra_bytes + 1u)) + 1u))))
+        {
+            extra_bytes += 1u;
+        }
+
+        uint32_t lead_bits = (0xff00u >> (extra_bytes + 1u)) & 0xffu;
+        _put_bits(encoder, lead_bits | (frame_number >> (6u * extra_bytes)), 8u);
+        for (uint32_t i = extra_bytes; i > 0u; i--)
+        {
+            _put_bits(encoder, 0x80u | ((frame_number >> (6u * (i - 1u))) & 0x3fu), 8u);
+        }
+    }
+
+    _put_bits(encoder, block_size - 1u, 16u);
+
+    // CRC-8 of the frame header, polynomial x^8 + x^2 + x + 1
+    uint8_t crc8 = 0u;
+    for (uint32_t i = header_start; i < encoder->output_len; i++)
+    {
+        crc8 ^= encoder->output[i];
+        for (uint32_t j = 0u; j < 8u; j++)
+        {
+            crc8 = (uint8_t) ((0u != (crc8 & 0x80u)) ? (((unsigned int) crc8 << 1u) ^ 0x07u) : ((unsigned int) crc8 << 1u));
+        }
+    }
+
+    _put_bits(encoder, crc8, 8u);
+
+    for (uint32_t channel = 0u; channel < channels; channel++)
+    {
+        _encode_subframe(encoder, channel, channels, block_size);
+    }
+
+    // Pad to a byte boundary, then CRC-16 of the whole frame
+    if (0u < encoder->bit_count)
+    {
+        _put_bits(encoder, 0u, 8u - encoder->bit_count);
+    }
+
+    _put_bits(encoder, encoder->crc16, 16u);
+
+    uint32_t frame_size = (uint32_t) (encoder->bytes_written - frame_start);
+    if ((0u == encoder->min_frame_size) || (frame_size < encoder->min_frame_size))
+    {
+        encoder->min_frame_size = frame_size;
+    }
+
+    if (frame_size > encoder->max_frame_size)
+    {
+        encoder->max_frame_size = frame_size;
+    }
+}
+
+// Write a big-endian value of 'num_bytes' bytes, and return a pointer to the next byte
+static uint8_t *_put_be(uint8_t *dest, uint64_t value, uint32_t num_bytes)
+{
+    for (uint32_t i = 0u; i < num_bytes; i++)
+    {
+        dest[i] = (uint8_t) ((value >> ((num_bytes - 1u - i) * 8u)) & 0xffu);
+    }
+
+    return dest + num_bytes;
+}
+
+/**
+ * Populate the 'fLaC' marker and STREAMINFO metadata block
+ *
+ * @param header        Pointer to location to write header, must have space for
+ *                      FLAC_STREAM_HEADER_SIZE bytes
+ * @param encoder       Pointer to encoder state, for minimum/maximum frame sizes
+ * @param sample_rate   Sampling rate
+ * @param channels      Number of channels
+ * @param total_samples Total number of sample frames in the stream
+ * @param md5           Pointer to 16-byte MD5 signature, or NULL if unknown
+ */
+static void _populate_header(uint8_t *header, ptttl_flac_encoder_t *encoder, uint32_t sample_rate,
+                             uint32_t channels, uint64_t total_samples, const uint8_t *md5)
+{
+    uint8_t *pos = header;
+    pos[0] = 'f';
+    pos[1] = 'L';
+    pos[2] = 'a';
+    pos[3] = 'C';
+    pos += 4u;
+
+    // Metadata block header: last-metadata-block flag, block type 0 (STREAMINFO), and size
+    pos = _put_be(pos, 0x80000000u | FLAC_STREAMINFO_SIZE, 4u);
+
+    pos = _put_be(pos, PTTTL_FLAC_BLOCK_SIZE, 2u);          // Minimum block size
+    pos = _put_be(pos, PTTTL_FLAC_BLOCK_SIZE, 2u);          // Maximum block size
+    pos = _put_be(pos, encoder->min_frame_size, 3u);        // 0 if unknown
+    pos = _put_be(pos, encoder->max_frame_size, 3u);        // 0 if unknown
+
+    // Sample rate (20 bits), channels - 1 (3 bits), bits per sample - 1 (5 bits), total samples (36 bits)
+    if (total_samples > FLAC_MAX_TOTAL_SAMPLES)
+    {
+        total_samples = 0u;                                 // Unknown
+    }
+
+    uint64_t fields = (((uint64_t) sample_rate) << 44u) | (((uint64_t) channels - 1u) << 41u) |
+                      (((uint64_t) BITS_PER_SAMPLE - 1u) << 36u) | total_samples;
+    pos = _put_be(pos, fields, 8u);
+
+    for (uint32_t i = 0u; i < 16u; i++)
+    {
+        pos[i] = (NULL == md5) ? 0u : md5[i];               // All zeros if unknown
+    }
+}
+
+
+// Store a description of the last error
+static ptttl_parser_error_t _error = {.line = 0u, .column = 0u, .error_message=NULL};
+
+
+// Helper macro, stores information about an error, which can be retrieved by ptttl_to_flac_error()
+#define ERROR(_parser, _msg)                                \
+{                                                           \
+    _error.error_message = _msg;                            \
+    _error.line = _parser->active_stream->line;             \
+    _error.column = _parser->active_stream->column;         \
+}
+
+
+/**
+ * @see ptttl_to_flac.h
+ */
+ptttl_parser_error_t ptttl_to_flac_error(void)
+{
+    return _error;
+}
+
+
+/**
+ * @see ptttl_to_flac.h
+ */
+int ptttl_to_flac_sink(ptttl_parser_t *parser, ptttl_output_sink_t *sink,
+                       ptttl_flac_encoder_t *encoder, ptttl_to_flac_config_t *config)
+{
+    if (NULL == parser)
+    {
+        return -1;
+    }
+
+    if ((NULL == sink) || (NULL == sink->write) || (NULL == encoder) || (NULL == config))
+    {
+        ERROR(parser, "NULL pointer passed to function");
+        return -1;
+    }
+
+    if (PTTTL_SAMPLE_FORMAT_S16 != config->generator_config.sample_format)
+    {
+        ERROR(parser, "FLAC encoding requires signed 16-bit samples");
+        return -1;
+    }
+
+    uint32_t channels = config->generator_config.output_channels;
+    if (0u == channels)
+    {
+        // 0 output channels means mono
+        channels = 1u;
+    }
+
+    if ((PTTTL_MAX_OUTPUT_CHANNELS < channels) || (FLAC_MAX_CHANNELS < channels))
+    {
+        ERROR(parser, "Invalid number of output channels");
+        return -1;
+    }
+
+    // Find the total sample count first, so STREAMINFO can be written before the frames
+    uint64_t total_samples = 0u;
+    int ret = ptttl_compute_total_samples(parser, &config->generator_config, &total_samples);
+    if (ret < 0)
+    {
+        _error = ptttl_sample_generator_error();
+        return ret;
+    }
+
+    ptttl_sample_generator_t generator;
+    ret = ptttl_sample_generator_create(parser, &generator, &config->generator_config);
+    if (ret < 0)
+    {
+        _error = ptttl_sample_generator_error();
+        return ret;
+    }
+
+    encoder->sink = sink;
+    encoder->output_len = 0u;
+    encoder->bit_buffer = 0u;
+    encoder->bit_count = 0u;
+    encoder->crc16 = 0u;
+    encoder->min_frame_size = 0u;
+    encoder->max_frame_size = 0u;
+    encoder->error = 0;
+    _md5_init(encoder);
+
+    // MD5 signature and frame sizes can only be written if the sink can seek back to STREAMINFO
+    uint8_t seekable = (NULL != sink->seek) ? 1u : 0u;
+
+    uint8_t header[FLAC_STREAM_HEADER_SIZE];
+    _populate_header(header, encoder, config->generator_config.sample_rate, channels, total_samples, NULL);
+
+    if (0 != sink->write(sink->context, header, sizeof(header)))
+    {
+        ERROR(parser, "Failed to write to FLAC file");
+        return -1;
+    }
+
+    encoder->bytes_written = sizeof(header);
+
+    // Generate one block of samples at a time and encode each block as a frame
+    uint32_t frame_number = 0u;
+    do
+    {
+        uint32_t num_samples = PTTTL_FLAC_BLOCK_SIZE;
+        ret = ptttl_sample_generator_generate(&generator, &num_samples, encoder->samples);
+        if (ret < 0)
+        {
+            _error = ptttl_sample_generator_error();
+            return ret;
+        }
+
+        if (0u == num_samples)
+        {
+            break;
+        }
+
+        if (1u == seekable)
+        {
+            for (uint32_t i = 0u; i < (num_samples * channels); i++)
+            {
+                uint16_t sample = (uint16_t) encoder->samples[i];
+                _md5_add_byte(encoder, (uint8_t) (sample & 0xffu));
+                _md5_add_byte(encoder, (uint8_t) (sample >> 8u));
+            }
+        }
+
+        _encode_frame(encoder, channels, num_samples, frame_number);
+        frame_number += 1u;
+
+        if (0 != encoder->error)
+        {
+            ERROR(parser, "Failed to write to FLAC file");
+            return -1;
+        }
+    }
+    while (0 == ret);
+
+    _flush_output(encoder);
+    if (0 != encoder->error)
+    {
+        ERROR(parser, "Failed to write to FLAC file");
+        return -1;
+    }
+
+    // Go back and fill in the MD5 signature and frame sizes, if possible
+    if ((1u == seekable) && (0 == sink->seek(sink->context, 0u)))
+    {
+        uint8_t md5[16];
+        _md5_finish(encoder, md5);
+        _populate_header(header, encoder, config->generator_config.sample_rate, channels, total_samples, md5);
+
+        if ((0 != sink->write(sink->context, header, sizeof(header))) ||
+            (0 != sink->seek(sink->context, encoder->bytes_written)))
+        {
+            ERROR(parser, "Failed to write to FLAC file");
+            return -1;
+        }
+    }
+
+    if ((NULL != sink->flush) && (0 != sink->flush(sink->context)))
+    {
+        ERROR(parser, "Failed to write to FLAC file");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @see ptttl_to_flac.h
+ */
+int ptttl_to_flac(ptttl_parser_t *parser, const char *flac_filename, ptttl_flac_encoder_t *encoder)
+{
+    if (NULL == parser)
+    {
+        return -1;
+    }
+
+    if (NULL == flac_filename)
+    {
+        ERROR(parser, "NULL pointer passed to function");
+        return -1;
+    }
+
+    FILE *fp = fopen(flac_filename, "wb");
+    if (NULL == fp)
+    {
+        ERROR(parser, "Unable to open FLAC file for writing");
+        return -1;
+    }
+
+    ptttl_output_sink_t sink;
+    ptttl_to_flac_config_t config = PTTTL_TO_FLAC_CONFIG_DEFAULT;
+
+    int ret = ptttl_output_sink_init_stdio(&sink, fp);
+    if (0 == ret)
+    {
+        ret = ptttl_to_flac_sink(parser, &sink, encoder, &config);
+    }
+
+    fclose(fp);
+
+    return ret;
+}
@@ -0,0 +1,148 @@
+/* ptttl_to_flac.h
+ *
+ * Converts the output of ptttl_parse() into a FLAC file (lossless compression).
+ * No dynamic memory allocation, and no loading the entire FLAC file in memory.
+ *
+ * Requires ptttl_parser.c, ptttl_sample_generator.c and ptttl_output_sink.c
+ *
+ * Requires stdint.h, and fopen/fwrite from stdio.h
+ *
+ * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
+ *
+ * Erik Nyquist 2025
+ */
+
+#ifndef PTTTL_TO_FLAC_H
+#define PTTTL_TO_FLAC_H
+
+
+#include <stdio.h>
+#include "ptttl_parser.h"
+#include "ptttl_sample_generator.h"
+#include "ptttl_output_sink.h"
+
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+
+/**
+ * Number of sample frames in each FLAC block. Each block is generated into the sample
+ * buffer of ptttl_flac_encoder_t, and then encoded as a single FLAC frame. Larger
+ * blocks compress slightly better, but increase the size of ptttl_flac_encoder_t.
+ * Must be between 16 and 65535.
+ */
+#ifndef PTTTL_FLAC_BLOCK_SIZE
+#define PTTTL_FLAC_BLOCK_SIZE (4096u)
+#endif // PTTTL_FLAC_BLOCK_SIZE
+
+/**
+ * Size in bytes of the buffer that encoded data is collected in, before it is written
+ * to the output sink. This setting affects the size of ptttl_flac_encoder_t.
+ * Must be at least 32.
+ */
+#ifndef PTTTL_FLAC_OUTPUT_BUFFER_SIZE
+#define PTTTL_FLAC_OUTPUT_BUFFER_SIZE (512u)
+#endif // PTTTL_FLAC_OUTPUT_BUFFER_SIZE
+
+/**
+ * Largest Rice partition order to try when encoding residuals. Higher values allow
+ * Rice parameters to follow the signal more closely within a block (e.g. across note
+ * boundaries), at the cost of more encoding time. Must be between 0 and 15.
+ */
+#ifndef PTTTL_FLAC_MAX_PARTITION_ORDER
+#define PTTTL_FLAC_MAX_PARTITION_ORDER (6u)
+#endif // PTTTL_FLAC_MAX_PARTITION_ORDER
+
+
+/**
+ * ptttl_to_flac_config_t object initialization with sane defaults
+ */
+#define PTTTL_TO_FLAC_CONFIG_DEFAULT {.generator_config=PTTTL_SAMPLE_GENERATOR_CONFIG_DEFAULT}
+
+
+/**
+ * Holds configurable parameters for FLAC file generation
+ */
+typedef struct
+{
+    ptttl_sample_generator_config_t generator_config; ///< Sample generator configuration, must use signed 16-bit samples
+} ptttl_to_flac_config_t;
+
+
+/**
+ * Holds the state of a FLAC encoder. This struct is large (mostly the sample buffer
+ * for one block), so it is provided by the caller rather than allocated on the stack.
+ */
+typedef struct
+{
+    int16_t samples[PTTTL_FLAC_BLOCK_SIZE * PTTTL_MAX_OUTPUT_CHANNELS]; ///< Samples for the current block
+    uint8_t output[PTTTL_FLAC_OUTPUT_BUFFER_SIZE]; ///< Encoded data not yet written to the sink
+    uint32_t output_len;                           ///< No. of bytes in the output buffer
+    uint64_t bit_buffer;                           ///< Bits not yet written to the output buffer
+    uint32_t bit_count;                            ///< No. of bits in bit_buffer
+    uint16_t crc16;                                ///< CRC-16 of the current frame so far
+    uint64_t bytes_written;                        ///< Total no. of bytes encoded so far
+    uint32_t min_frame_size;                       ///< Size of the smallest frame so far, in bytes
+    uint32_t max_frame_size;                       ///< Size of the largest frame so far, in bytes
+    uint8_t partition_params[1u << PTTTL_FLAC_MAX_PARTITION_ORDER]; ///< Rice parameters for current subframe
+    uint32_t md5_state[4];                         ///< MD5 digest state of all samples so far
+    uint8_t md5_block[64];                         ///< Sample bytes not yet added to the MD5 digest
+    uint64_t md5_length;                           ///< Total no. of sample bytes added to the MD5 digest
+    ptttl_output_sink_t *sink;                     ///< Sink that encoded data is written to
+    int error;                                     ///< -1 if writing to the sink has failed
+} ptttl_flac_encoder_t;
+
+
+/**
+ * Return error info after ptttl_to_flac has returned -1
+ *
+ * @return  Object describing the error that occurred. error_message field will be NULL
+ *          if no error has occurred.
+ */
+ptttl_parser_error_t ptttl_to_flac_error(void);
+
+/**
+ * Generate samples for some parsed PTTTL data and write them to an output sink in FLAC
+ * format. Samples are generated one block at a time, and each block is encoded as soon
+ * as it is generated using fixed linear predictors and Rice coding. No dynamic memory
+ * allocation.
+ *
+ * The total length is calculated up front with #ptttl_compute_total_samples, so the
+ * output is written strictly sequentially, and the sink does not need to support
+ * seeking. If the sink does support seeking, then the STREAMINFO block is updated at
+ * the end with the minimum/maximum frame sizes and the MD5 signature of the samples,
+ * which allows decoders to verify the decoded samples; otherwise, these are left unset.
+ *
+ * @param parser         Pointer to initialized parser object
+ * @param sink           Pointer to output sink to write FLAC data to
+ * @param encoder        Pointer to encoder state object
+ * @param config         Pointer to FLAC generation configuration data
+ *
+ * @return 0 if successful, -1 if an error occurred. Call #ptttl_to_flac_error for
+ *         an error description if -1 is returned.
+ */
+int ptttl_to_flac_sink(ptttl_parser_t *parser, ptttl_output_sink_t *sink,
+                       ptttl_flac_encoder_t *encoder, ptttl_to_flac_config_t *config);
+
+/**
+ * Generate samples for some parsed PTTTL data and write them to a FLAC file with the
+ * default configuration. No dynamic memory allocation. Does not require holding the
+ * entire FLAC file in memory at once.
+ *
+ * @param parser         Pointer to initialized parser object
+ * @param flac_filename  Filename for FLAC file
+ * @param encoder        Pointer to encoder state object
+ *
+ * @return 0 if successful, -1 if an error occurred. Call #ptttl_to_flac_error for
+ *         an error description if -1 is returned.
+ */
+int ptttl_to_flac(ptttl_parser_t *parser, const char *flac_filename, ptttl_flac_encoder_t *encoder);
+
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // PTTTL_TO_FLAC_H
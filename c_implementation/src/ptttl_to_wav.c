@@ -5,7 +5,7 @@
  *
  * Requires ptttl_parser.c and ptttl_sample_generator.c
  *
- * Requires stdint.h, and fopen/fseek/fwrite from stdio.h
+ * Requires stdint.h, and fopen/fwrite from stdio.h
  *
  * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
  *
@@ -16,58 +16,560 @@
 #include <stdint.h>
 
 #include "ptttl_to_wav.h"
-#include "ptttl_sample_generator.h"
 
 
-// Sample width in bits
-#define BITS_PER_SAMPLE (16)
+#if (PTTTL_TO_WAV_ADPCM_BLOCK_SIZE < 8u) || (0u != (PTTTL_TO_WAV_ADPCM_BLOCK_SIZE % 4u))
+#error "PTTTL_TO_WAV_ADPCM_BLOCK_SIZE must be a multiple of 4, and at least 8"
+#endif
+
+
+// Format tag for integer PCM data
+#define WAV_FORMAT_PCM (1u)
+
+// Format tag for IEEE floating point data
+#define WAV_FORMAT_IEEE_FLOAT (3u)
+
+// Format tag for G.711 A-law data
+#define WAV_FORMAT_ALAW (6u)
+
+// Format tag for G.711 mu-law data
+#define WAV_FORMAT_MULAW (7u)
+
+// Format tag for IMA ADPCM data (WAVE_FORMAT_DVI_ADPCM)
+#define WAV_FORMAT_IMA_ADPCM (0x11u)
+
+// Size of the 'fmt ' chunk body for PCM data
+#define FMT_CHUNK_SIZE (16u)
+
+// Size of the 'fmt ' chunk body for non-PCM data, with an empty extension (cbSize=0)
+#define FMT_EXTENSIBLE_CHUNK_SIZE (FMT_CHUNK_SIZE + 2u)
+
+// Size of the 'fmt ' chunk body for IMA ADPCM data, with the samples-per-block extension
+#define FMT_ADPCM_CHUNK_SIZE (FMT_EXTENSIBLE_CHUNK_SIZE + 2u)
+
+// Size of the 'fact' chunk body
+#define FACT_CHUNK_SIZE (4u)
+
+// Size of the 'ds64' chunk body, with no table entries
+#define DS64_CHUNK_SIZE (28u)
+
+// Size of the largest possible standard WAV header: 'RIFF' header, 'fmt ' chunk, 'fact' chunk and 'data' chunk header
+#define WAV_HEADER_MAX_SIZE (12u + (8u + FMT_ADPCM_CHUNK_SIZE) + (8u + FACT_CHUNK_SIZE) + 8u)
+
+// Size of the largest possible RF64 header: same as a standard WAV header, plus a 'ds64' chunk
+#define RF64_HEADER_MAX_SIZE (WAV_HEADER_MAX_SIZE + (8u + DS64_CHUNK_SIZE))
+
+/* Chunk size value used in the 'RIFF' and 'data' chunk headers of an RF64 file,
+ * indicating that the real size should be read from the 'ds64' chunk */
+#define RF64_SIZE_PLACEHOLDER (0xFFFFFFFFu)
+
+// Size of the header at the start of each channel in an IMA ADPCM block
+#define ADPCM_CHANNEL_HEADER_SIZE (4u)
+
+// Number of bytes of 4-bit codes stored for one channel, before moving on to the next channel
+#define ADPCM_CHANNEL_WORD_SIZE (4u)
+
+// Number of entries in the IMA ADPCM step size table
+#define ADPCM_STEP_TABLE_SIZE (89)
+
+// Largest sample magnitude that can be encoded as G.711 mu-law, before the bias is added
+#define MULAW_CLIP (32635)
+
+// Bias added to sample magnitudes before G.711 mu-law encoding
+#define MULAW_BIAS (0x84)
+
+
+/* The header of a wav file is written field by field in little-endian byte order.
+ * Based on: https://ccrma.stanford.edu/courses/422/projects/WaveFormat/
+ *
+ * If the data is too large for the 32-bit chunk sizes of a standard WAV file, then
+ * an RF64 header (EBU Tech 3306) is written instead, which holds 64-bit sizes in
+ * a 'ds64' chunk. */
+
+// Write a 4-character chunk ID, and return a pointer to the next byte
+static uint8_t *_put_id(uint8_t *dest, const char *id)
+{
+    for (unsigned int i = 0u; i < 4u; i++)
+    {
+        dest[i] = (uint8_t) id[i];
+    }
+
+    return dest + 4u;
+}
+
+// Write a 16-bit little-endian value, and return a pointer to the next byte
+static uint8_t *_put_u16(uint8_t *dest, uint16_t value)
+{
+    dest[0] = (uint8_t) (value & 0xffu);
+    dest[1] = (uint8_t) ((value >> 8u) & 0xffu);
+    return dest + 2u;
+}
+
+// Write a 32-bit little-endian value, and return a pointer to the next byte
+static uint8_t *_put_u32(uint8_t *dest, uint32_t value)
+{
+    dest = _put_u16(dest, (uint16_t) (value & 0xffffu));
+    return _put_u16(dest, (uint16_t) ((value >> 16u) & 0xffffu));
+}
+
+// Write a 64-bit little-endian value, and return a pointer to the next byte
+static uint8_t *_put_u64(uint8_t *dest, uint64_t value)
+{
+    dest = _put_u32(dest, (uint32_t) (value & 0xffffffffu));
+    return _put_u32(dest, (uint32_t) ((value >> 32u) & 0xffffffffu));
+}
 
 
 /**
- * The header of a wav file Based on:
- * https://ccrma.stanford.edu/courses/422/projects/WaveFormat/
+ * Describes how samples in one of the supported sample formats are stored in a WAV file
  */
 typedef struct
 {
-    char chunk_id[4];
-    int32_t chunk_size;
-    char format[4];
+    uint16_t format_tag;        ///< WAV format tag, 0 if the sample format is not supported
+    uint16_t bits_per_sample;   ///< Sample width in bits
+} wav_format_t;
 
-    char subchunk1_id[4];
-    int32_t subchunk1_size;
-    int16_t audio_format;
-    int16_t num_channels;
-    int32_t sample_rate;
-    int32_t byte_rate;
-    int16_t block_align;
-    int16_t bits_per_sample;
 
-    char subchunk2_id[4];
-    int32_t subchunk2_size;
-} wavfile_header_t;
+/**
+ * Describes the contents of the 'fmt ' chunk of a WAV file, and how sample frames are
+ * grouped into blocks in the 'data' chunk
+ */
+typedef struct
+{
+    uint16_t format_tag;        ///< WAV format tag
+    uint16_t channels;          ///< Number of channels (interleaved samples per frame)
+    uint16_t bits_per_sample;   ///< Sample width in bits
+    uint16_t block_align;       ///< Size of one block of sample frames, in bytes
+    uint32_t frames_per_block;  ///< Number of sample frames in one block (1 for uncompressed data)
+} wav_fmt_t;
+
 
 /**
- * WAV header data with all fixed/known values populated
+ * Holds the state of a streaming IMA ADPCM encoder. Sample frames are encoded into
+ * a single block as they arrive, and the block is written out once it is full.
  */
-static wavfile_header_t _default_header =
+typedef struct
+{
+    int32_t predictor[PTTTL_MAX_OUTPUT_CHANNELS];   ///< Predicted value of the next sample, per channel
+    int32_t step_index[PTTTL_MAX_OUTPUT_CHANNELS];  ///< Index into step size table, per channel
+    uint32_t block_frames;                          ///< Number of sample frames in the current block
+    uint8_t block[PTTTL_TO_WAV_ADPCM_BLOCK_SIZE * PTTTL_MAX_OUTPUT_CHANNELS]; ///< Current block
+} adpcm_encoder_t;
+
+
+// WAV format details for each sample format, indexed by ptttl_sample_format_e
+static const wav_format_t _wav_formats[PTTTL_SAMPLE_FORMAT_COUNT] =
 {
-    .chunk_id = {'R', 'I', 'F', 'F'},
-    .chunk_size = 0,
-    .format = {'W', 'A', 'V', 'E'},
+    [PTTTL_SAMPLE_FORMAT_S16] = {.format_tag=WAV_FORMAT_PCM, .bits_per_sample=16u},
+    [PTTTL_SAMPLE_FORMAT_FLOAT32] = {.format_tag=WAV_FORMAT_IEEE_FLOAT, .bits_per_sample=32u},
+    [PTTTL_SAMPLE_FORMAT_S24] = {.format_tag=WAV_FORMAT_PCM, .bits_per_sample=24u},
+    [PTTTL_SAMPLE_FORMAT_S8] = {.format_tag=0u, .bits_per_sample=8u}, // WAV 8-bit PCM is always unsigned
+    [PTTTL_SAMPLE_FORMAT_U8] = {.format_tag=WAV_FORMAT_PCM, .bits_per_sample=8u}
+};
 
-    .subchunk1_id = {'f', 'm', 't', ' '},
-    .subchunk1_size = BITS_PER_SAMPLE,
-    .audio_format = 1,
-    .num_channels = 1,
-    .sample_rate = 0u,
-    .byte_rate = 0u,
-    .block_align = BITS_PER_SAMPLE / 8,
-    .bits_per_sample = BITS_PER_SAMPLE,
 
-    .subchunk2_id = {'d', 'a', 't', 'a'},
-    .subchunk2_size = 0
+// IMA ADPCM step sizes
+static const int16_t _adpcm_step_table[ADPCM_STEP_TABLE_SIZE] =
+{
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
 };
 
+// IMA ADPCM step index adjustments, indexed by 4-bit code
+static const int8_t _adpcm_index_table[16] =
+{
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+
+// G.711 segment (exponent) number, indexed by the top 8 bits of a biased mu-law sample magnitude
+static const uint8_t _mulaw_exponent_table[256] =
+{
+    0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7
+};
+
+// G.711 segment (exponent) number, indexed by bits 8-14 of an A-law sample magnitude
+static const uint8_t _alaw_exponent_table[128] =
+{
+    1, 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7
+};
+
+
+/**
+ * Populate a WAV header (or an RF64 header, if the data size requires it)
+ *
+ * @param header       Pointer to location to write header, must have space for
+ *                     RF64_HEADER_MAX_SIZE bytes
+ * @param fmt          Pointer to 'fmt ' chunk contents
+ * @param sample_rate  Sampling rate
+ * @param framecount   Total number of sample frames in the file
+ *
+ * @return Size of populated header in bytes
+ */
+static size_t _populate_header(uint8_t *header, const wav_fmt_t *fmt, uint32_t sample_rate,
+                               uint64_t framecount)
+{
+    // Non-PCM formats require an extended 'fmt ' chunk, and a 'fact' chunk
+    uint8_t extended = (WAV_FORMAT_PCM == fmt->format_tag) ? 0u : 1u;
+    uint32_t fmt_size = FMT_CHUNK_SIZE;
+    if (WAV_FORMAT_IMA_ADPCM == fmt->format_tag)
+    {
+        fmt_size = FMT_ADPCM_CHUNK_SIZE;
+    }
+    else if (1u == extended)
+    {
+        fmt_size = FMT_EXTENSIBLE_CHUNK_SIZE;
+    }
+
+    uint32_t header_size = 12u + (8u + fmt_size) + 8u;
+    if (1u == extended)
+    {
+        header_size += 8u + FACT_CHUNK_SIZE;
+    }
+
+    // The last block is always written in full, even if it is not full of samples
+    uint64_t blockcount = (framecount + fmt->frames_per_block - 1u) / fmt->frames_per_block;
+    uint64_t data_size = blockcount * fmt->block_align;
+    uint64_t riff_size = (header_size - 8u) + data_size;
+    uint8_t rf64 = (riff_size > (uint64_t) UINT32_MAX) ? 1u : 0u;
+    uint8_t *pos = header;
+
+    if (1u == rf64)
+    {
+        riff_size += 8u + DS64_CHUNK_SIZE;
+
+        pos = _put_id(pos, "RF64");
+        pos = _put_u32(pos, RF64_SIZE_PLACEHOLDER);
+        pos = _put_id(pos, "WAVE");
+
+        pos = _put_id(pos, "ds64");
+        pos = _put_u32(pos, DS64_CHUNK_SIZE);
+        pos = _put_u64(pos, riff_size);
+        pos = _put_u64(pos, data_size);
+        pos = _put_u64(pos, framecount);
+        pos = _put_u32(pos, 0u);             // No table entries
+    }
+    else
+    {
+        pos = _put_id(pos, "RIFF");
+        pos = _put_u32(pos, (uint32_t) riff_size);
+        pos = _put_id(pos, "WAVE");
+    }
+
+    uint64_t byte_rate = ((uint64_t) sample_rate * fmt->block_align) / fmt->frames_per_block;
+
+    pos = _put_id(pos, "fmt ");
+    pos = _put_u32(pos, fmt_size);
+    pos = _put_u16(pos, fmt->format_tag);
+    pos = _put_u16(pos, fmt->channels);
+    pos = _put_u32(pos, sample_rate);
+    pos = _put_u32(pos, (uint32_t) byte_rate);
+    pos = _put_u16(pos, fmt->block_align);
+    pos = _put_u16(pos, fmt->bits_per_sample);
+
+    if (WAV_FORMAT_IMA_ADPCM == fmt->format_tag)
+    {
+        pos = _put_u16(pos, 2u);             // Extension size (cbSize)
+        pos = _put_u16(pos, (uint16_t) fmt->frames_per_block);
+    }
+    else if (1u == extended)
+    {
+        pos = _put_u16(pos, 0u);             // No extension data (cbSize)
+    }
+
+    if (1u == extended)
+    {
+        pos = _put_id(pos, "fact");
+        pos = _put_u32(pos, FACT_CHUNK_SIZE);
+        pos = _put_u32(pos, (1u == rf64) ? RF64_SIZE_PLACEHOLDER : (uint32_t) framecount);
+    }
+
+    pos = _put_id(pos, "data");
+    pos = _put_u32(pos, (1u == rf64) ? RF64_SIZE_PLACEHOLDER : (uint32_t) data_size);
+
+    return (size_t) (pos - header);
+}
+
+
+/**
+ * Encode a single 16-bit sample as a 4-bit IMA ADPCM code, and update the encoder
+ * state for one channel
+ *
+ * @param predictor    Pointer to predicted value of the sample, for the channel
+ * @param step_index   Pointer to step size table index, for the channel
+ * @param sample       Sample to encode
+ *
+ * @return 4-bit IMA ADPCM code
+ */
+static uint8_t _adpcm_encode_sample(int32_t *predictor, int32_t *step_index, int16_t sample)
+{
+    int32_t step = _adpcm_step_table[*step_index];
+    int32_t diff = (int32_t) sample - *predictor;
+    uint8_t code = 0u;
+
+    if (diff < 0)
+    {
+        code = 8u;
+        diff = -diff;
+    }
+
+    // Quantize the difference to 3 bits, tracking the value the decoder will reconstruct
+    int32_t delta = step >> 3;
+    if (diff >= step)
+    {
+        code |= 4u;
+        diff -= step;
+        delta += step;
+    }
+
+    step >>= 1;
+    if (diff >= step)
+    {
+        code |= 2u;
+        diff -= step;
+        delta += step;
+    }
+
+    step >>= 1;
+    if (diff >= step)
+    {
+        code |= 1u;
+        delta += step;
+    }
+
+    *predictor += (0u != (code & 8u)) ? -delta : delta;
+    if (*predictor > INT16_MAX)
+    {
+        *predictor = INT16_MAX;
+    }
+    else if (*predictor < INT16_MIN)
+    {
+        *predictor = INT16_MIN;
+    }
+
+    *step_index += _adpcm_index_table[code];
+    if (*step_index < 0)
+    {
+        *step_index = 0;
+    }
+    else if (*step_index >= ADPCM_STEP_TABLE_SIZE)
+    {
+        *step_index = ADPCM_STEP_TABLE_SIZE - 1;
+    }
+
+    return code;
+}
+
+
+/**
+ * Encode a single 16-bit sample as G.711 mu-law
+ *
+ * @param sample   Sample to encode
+ *
+ * @return mu-law encoded sample
+ */
+static uint8_t _mulaw_encode_sample(int16_t sample)
+{
+    int32_t magnitude = sample;
+    uint8_t sign = 0u;
+
+    // Negative samples are one's complemented, as in the ITU-T G.191 reference encoder
+    if (magnitude < 0)
+    {
+        sign = 0x80u;
+        magnitude = -magnitude - 1;
+    }
+
+    if (magnitude > MULAW_CLIP)
+    {
+        magnitude = MULAW_CLIP;
+    }
+
+    magnitude += MULAW_BIAS;
+
+    uint8_t exponent = _mulaw_exponent_table[(magnitude >> 7) & 0xff];
+    uint8_t mantissa = (uint8_t) ((magnitude >> (exponent + 3u)) & 0x0f);
+
+    // mu-law codes are stored inverted
+    return (uint8_t) ~(sign | (uint8_t) (exponent << 4u) | mantissa);
+}
+
+
+/**
+ * Encode a single 16-bit sample as G.711 A-law
+ *
+ * @param sample   Sample to encode
+ *
+ * @return A-law encoded sample
+ */
+static uint8_t _alaw_encode_sample(int16_t sample)
+{
+    int32_t magnitude = sample;
+    uint8_t sign = 0x80u;
+
+    if (magnitude < 0)
+    {
+        sign = 0u;
+        magnitude = -magnitude - 1;
+    }
+
+    uint8_t code;
+    if (magnitude >= 256)
+    {
+        uint8_t exponent = _alaw_exponent_table[(magnitude >> 8) & 0x7f];
+        uint8_t mantissa = (uint8_t) ((magnitude >> (exponent + 3u)) & 0x0f);
+        code = (uint8_t) (exponent << 4u) | mantissa;
+    }
+    else
+    {
+        code = (uint8_t) (magnitude >> 4);
+    }
+
+    // A-law codes are stored with even bits inverted
+    return code ^ (sign ^ 0x55u);
+}
+
+
+/**
+ * Encode 16-bit samples as G.711 mu-law or A-law, in place. Each 8-bit encoded sample
+ * is stored at or before the position of the 16-bit sample it was encoded from, so no
+ * additional buffer is needed.
+ *
+ * @param format_tag   WAV_FORMAT_MULAW or WAV_FORMAT_ALAW
+ * @param samples      Pointer to samples to encode
+ * @param num_samples  Number of samples to encode
+ */
+static void _g711_encode(uint16_t format_tag, void *samples, uint32_t num_samples)
+{
+    const int16_t *input = (const int16_t *) samples;
+    uint8_t *output = (uint8_t *) samples;
+
+    for (uint32_t i = 0u; i < num_samples; i++)
+    {
+        int16_t sample = input[i];
+        output[i] = (WAV_FORMAT_MULAW == format_tag) ? _mulaw_encode_sample(sample) : _alaw_encode_sample(sample);
+    }
+}
+
+
+/**
+ * Encode a single sample frame into the current IMA ADPCM block, and write the block
+ * to the sink once it is full
+ *
+ * @param encoder  Pointer to encoder state
+ * @param fmt      Pointer to 'fmt ' chunk contents
+ * @param sink     Pointer to output sink to write completed blocks to
+ * @param frame    Pointer to one sample for each channel
+ *
+ * @return 0 if successful, -1 if writing to the sink failed
+ */
+static int _adpcm_encode_frame(adpcm_encoder_t *encoder, const wav_fmt_t *fmt,
+                               ptttl_output_sink_t *sink, const int16_t *frame)
+{
+    if (0u == encoder->block_frames)
+    {
+        /* First frame of each block is stored uncompressed in the block header for each
+         * channel, along with the current step index */
+        for (uint32_t chan = 0u; chan < fmt->channels; chan++)
+        {
+            encoder->predictor[chan] = frame[chan];
+
+            uint8_t *chan_header = &encoder->block[chan * ADPCM_CHANNEL_HEADER_SIZE];
+            chan_header = _put_u16(chan_header, (uint16_t) frame[chan]);
+            chan_header[0] = (uint8_t) encoder->step_index[chan];
+            chan_header[1] = 0u;
+        }
+    }
+    else
+    {
+        /* Codes are packed 2 per byte (low nibble first), in words of 8 codes per channel,
+         * with the words for each channel interleaved */
+        uint32_t code_index = encoder->block_frames - 1u;
+        uint32_t word_offset = (fmt->channels * ADPCM_CHANNEL_HEADER_SIZE) +
+                               ((code_index / 8u) * fmt->channels * ADPCM_CHANNEL_WORD_SIZE);
+
+        for (uint32_t chan = 0u; chan < fmt->channels; chan++)
+        {
+            uint8_t code = _adpcm_encode_sample(&encoder->predictor[chan], &encoder->step_index[chan],
+                                                frame[chan]);
+
+            uint8_t *dest = &encoder->block[word_offset + (chan * ADPCM_CHANNEL_WORD_SIZE) +
+                                            ((code_index % 8u) / 2u)];
+            if (0u == (code_index % 2u))
+            {
+                *dest = code;
+            }
+            else
+            {
+                *dest |= (uint8_t) (code << 4u);
+            }
+        }
+    }
+
+    encoder->block_frames += 1u;
+
+    if (encoder->block_frames == fmt->frames_per_block)
+    {
+        encoder->block_frames = 0u;
+        return sink->write(sink->context, encoder->block, fmt->block_align);
+    }
+
+    return 0;
+}
+
+
+/**
+ * Pad the current IMA ADPCM block with silence, if it has been started, and write it
+ * to the sink
+ *
+ * @param encoder  Pointer to encoder state
+ * @param fmt      Pointer to 'fmt ' chunk contents
+ * @param sink     Pointer to output sink to write completed block to
+ *
+ * @return 0 if successful, -1 if writing to the sink failed
+ */
+static int _adpcm_finish(adpcm_encoder_t *encoder, const wav_fmt_t *fmt, ptttl_output_sink_t *sink)
+{
+    const int16_t silence[PTTTL_MAX_OUTPUT_CHANNELS] = {0};
+
+    while (0u != encoder->block_frames)
+    {
+        if (0 != _adpcm_encode_frame(encoder, fmt, sink, silence))
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 
 // Store a description of the last error
 static ptttl_parser_error_t _error = {.line = 0u, .column = 0u, .error_message=NULL};
@@ -82,6 +584,85 @@ static ptttl_parser_error_t _error = {.line = 0u, .column = 0u, .error_message=N
 }
 
 
+/**
+ * Fill out the contents of the 'fmt ' chunk for a WAV generation configuration
+ *
+ * @param parser   Pointer to initialized parser object, for error reporting
+ * @param config   Pointer to WAV generation configuration data
+ * @param fmt      Pointer to location to store 'fmt ' chunk contents
+ *
+ * @return 0 if successful, -1 if the configuration cannot be written to a WAV file
+ */
+static int _get_wav_fmt(ptttl_parser_t *parser, ptttl_to_wav_config_t *config, wav_fmt_t *fmt)
+{
+    ptttl_sample_format_e sample_format = config->generator_config.sample_format;
+    unsigned int channels = config->generator_config.output_channels;
+    if (0u == channels)
+    {
+        // 0 output channels means mono
+        channels = 1u;
+    }
+
+    if (PTTTL_MAX_OUTPUT_CHANNELS < channels)
+    {
+        ERROR(parser, "Invalid number of output channels");
+        return -1;
+    }
+
+    fmt->channels = (uint16_t) channels;
+
+    switch (config->encoding)
+    {
+        case PTTTL_WAV_ENCODING_PCM:
+            if ((PTTTL_SAMPLE_FORMAT_COUNT <= sample_format) || (0u == _wav_formats[sample_format].format_tag))
+            {
+                ERROR(parser, "Sample format is not supported in WAV files");
+                return -1;
+            }
+
+            fmt->format_tag = _wav_formats[sample_format].format_tag;
+            fmt->bits_per_sample = _wav_formats[sample_format].bits_per_sample;
+            fmt->block_align = (uint16_t) ((fmt->bits_per_sample / 8u) * channels);
+            fmt->frames_per_block = 1u;
+            break;
+
+        case PTTTL_WAV_ENCODING_IMA_ADPCM:
+            if (PTTTL_SAMPLE_FORMAT_S16 != sample_format)
+            {
+                ERROR(parser, "IMA ADPCM encoding requires signed 16-bit samples");
+                return -1;
+            }
+
+            // Header sample, plus 2 codes per byte in the rest of the block
+            fmt->format_tag = WAV_FORMAT_IMA_ADPCM;
+            fmt->bits_per_sample = 4u;
+            fmt->block_align = (uint16_t) (PTTTL_TO_WAV_ADPCM_BLOCK_SIZE * channels);
+            fmt->frames_per_block = ((PTTTL_TO_WAV_ADPCM_BLOCK_SIZE - ADPCM_CHANNEL_HEADER_SIZE) * 2u) + 1u;
+            break;
+
+        case PTTTL_WAV_ENCODING_MULAW:
+        case PTTTL_WAV_ENCODING_ALAW:
+            if (PTTTL_SAMPLE_FORMAT_S16 != sample_format)
+            {
+                ERROR(parser, "G.711 encoding requires signed 16-bit samples");
+                return -1;
+            }
+
+            fmt->format_tag = (PTTTL_WAV_ENCODING_MULAW == config->encoding) ? WAV_FORMAT_MULAW : WAV_FORMAT_ALAW;
+            fmt->bits_per_sample = 8u;
+            fmt->block_align = (uint16_t) channels;
+            fmt->frames_per_block = 1u;
+            break;
+
+        default:
+            ERROR(parser, "Invalid WAV encoding");
+            return -1;
+    }
+
+    return 0;
+}
+
+
 /**
  * @see ptttl_to_wav.h
  */
@@ -94,56 +675,159 @@ const ptttl_parser_error_t ptttl_to_wav_error(void)
 /**
  * @see ptttl_to_wav.h
  */
-int ptttl_to_wav(ptttl_parser_t *parser, const char *wav_filename)
+int ptttl_to_wav_range_sink(ptttl_parser_t *parser, ptttl_output_sink_t *sink,
+                            ptttl_to_wav_config_t *config, uint64_t start_sample,
+                            uint64_t end_sample)
 {
     if (NULL == parser)
     {
         return -1;
     }
 
-    if (NULL == wav_filename)
+    if ((NULL == sink) || (NULL == sink->write) || (NULL == config))
     {
         ERROR(parser, "NULL pointer passed to function");
+        return -1;
+    }
+
+    wav_fmt_t fmt;
+    if (0 != _get_wav_fmt(parser, config, &fmt))
+    {
+        return -1;
+    }
+
+    unsigned int channels = fmt.channels;
+
+    /* Use caller-provided sample buffer if there is one, otherwise use a stack buffer.
+     * Stack buffer is float, so that it is large enough and aligned for any sample format. */
+    float default_sample_buf[PTTTL_TO_WAV_DEFAULT_CHUNK_SAMPLES];
+    void *sample_buf = default_sample_buf;
+    uint32_t sample_buf_len = PTTTL_TO_WAV_DEFAULT_CHUNK_SAMPLES / channels;
+
+    if (NULL != config->sample_buf)
+    {
+        if (0u == config->sample_buf_len)
+        {
+            ERROR(parser, "Sample buffer length must be greater than 0");
+            return -1;
+        }
+
+        sample_buf = config->sample_buf;
+        sample_buf_len = config->sample_buf_len;
     }
 
     ptttl_sample_generator_t generator;
-    ptttl_sample_generator_config_t config = PTTTL_SAMPLE_GENERATOR_CONFIG_DEFAULT;
+    ptttl_sample_generator_config_t *generator_config = &config->generator_config;
+    uint64_t framecount = 0u;
+    int ret = 0;
+
+    /* The header needs the total sample count before any samples are written. A timeline
+     * or seek index already holds it; otherwise, find it with a pass over the whole song,
+     * before the sample generator starts parsing */
+    if ((NULL == generator_config->timeline) && (NULL == generator_config->seek_index))
+    {
+        ret = ptttl_compute_total_samples(parser, generator_config, &framecount);
+        if (ret < 0)
+        {
+            _error = ptttl_sample_generator_error();
+            return ret;
+        }
+    }
 
-    int ret = ptttl_sample_generator_create(parser, &generator, &config);
+    ret = ptttl_sample_generator_create(parser, &generator, generator_config);
     if (ret < 0)
     {
         _error = ptttl_sample_generator_error();
         return ret;
     }
 
-    FILE *fp = fopen(wav_filename, "wb");
-    if (NULL == fp)
+    if (NULL != generator_config->timeline)
     {
-        ERROR(parser, "Unable to open WAV file for writing");
+        framecount = generator_config->timeline->total_samples;
+    }
+    else if (NULL != generator_config->seek_index)
+    {
+        // Built by ptttl_sample_generator_create, if it had not been built already
+        framecount = generator_config->seek_index->total_samples;
+    }
+
+    // Only the requested window is written, so it sets the frame count in the header
+    if (end_sample > framecount)
+    {
+        end_sample = framecount;
+    }
+
+    if (start_sample > end_sample)
+    {
+        ERROR(parser, "Start of sample range is past the end of the range");
         return -1;
     }
 
-    // Seek to end of header, we'll generate samples first
-    ret = fseek(fp, sizeof(wavfile_header_t), SEEK_SET);
-    if (0 != ret)
+    framecount = end_sample - start_sample;
+
+    // Skip to the start of the window by note durations only, without synthesis
+    if ((0u < start_sample) && (0 != ptttl_sample_generator_seek(&generator, start_sample)))
     {
-        ERROR(parser, "Failed to seek within WAV file for writing");
-        fclose(fp);
+        _error = ptttl_sample_generator_error();
         return -1;
     }
 
-    // Generate 1k samples at a time and write to file, until all samples are generated
-    const uint32_t sample_buf_len = 1024;
-    int16_t sample_buf[sample_buf_len];
-    uint32_t num_samples = sample_buf_len;
+    if (0u == config->headerless)
+    {
+        uint8_t header[RF64_HEADER_MAX_SIZE];
+        size_t header_size = _populate_header(header, &fmt, config->generator_config.sample_rate, framecount);
+
+        // Write header
+        if (0 != sink->write(sink->context, header, header_size))
+        {
+            ERROR(parser, "Failed to write to WAV file");
+            return -1;
+        }
+    }
+
+    adpcm_encoder_t adpcm = {.block_frames=0u};
+
+    // Generate one chunk of samples at a time and write to sink, until the end of the window
+    uint64_t remaining = framecount;
+    uint32_t num_samples = (remaining < sample_buf_len) ? (uint32_t) remaining : sample_buf_len;
 
-    while ((ret = ptttl_sample_generator_generate(&generator, &num_samples, sample_buf)) != -1)
+    while ((0u < remaining) &&
+           ((ret = ptttl_sample_generator_generate(&generator, &num_samples, sample_buf)) != -1))
     {
-        size_t size_written = fwrite(&sample_buf, sizeof(uint16_t), num_samples, fp);
-        if (num_samples != size_written)
+        int write_ret = 0;
+
+        remaining -= num_samples;
+        if (0u == remaining)
+        {
+            ret = 1;
+        }
+
+        if (WAV_FORMAT_IMA_ADPCM == fmt.format_tag)
+        {
+            const int16_t *frames = (const int16_t *) sample_buf;
+            for (uint32_t i = 0u; (i < num_samples) && (0 == write_ret); i++)
+            {
+                write_ret = _adpcm_encode_frame(&adpcm, &fmt, sink, &frames[i * channels]);
+            }
+
+            if ((1 == ret) && (0 == write_ret))
+            {
+                write_ret = _adpcm_finish(&adpcm, &fmt, sink);
+            }
+        }
+        else
+        {
+            if ((WAV_FORMAT_MULAW == fmt.format_tag) || (WAV_FORMAT_ALAW == fmt.format_tag))
+            {
+                _g711_encode(fmt.format_tag, sample_buf, num_samples * channels);
+            }
+
+            write_ret = sink->write(sink->context, sample_buf, num_samples * fmt.block_align);
+        }
+
+        if (0 != write_ret)
         {
             ERROR(parser, "Failed to write to WAV file");
-            fclose(fp);
             return -1;
         }
 
@@ -152,41 +836,83 @@ int ptttl_to_wav(ptttl_parser_t *parser, const char *wav_filename)
             break;
         }
 
-        num_samples = sample_buf_len;
+        num_samples = (remaining < sample_buf_len) ? (uint32_t) remaining : sample_buf_len;
     }
 
     if (ret < 0)
     {
         _error = ptttl_sample_generator_error();
-        fclose(fp);
         return ret;
     }
 
-    // Seek back to beginning and populate header
-    ret = fseek(fp, 0u, SEEK_SET);
-    if (0 != ret)
+    if ((NULL != sink->flush) && (0 != sink->flush(sink->context)))
     {
-        ERROR(parser, "Failed to seek within WAV file for writing");
-        fclose(fp);
+        ERROR(parser, "Failed to write to WAV file");
         return -1;
     }
 
-    int32_t framecount = ((int32_t) generator.current_sample) + 1u;
-    _default_header.subchunk2_size = (framecount * BITS_PER_SAMPLE) / 8;
-    _default_header.chunk_size = (4  + (8 + _default_header.subchunk1_size)) + (8 + _default_header.subchunk2_size);
-    _default_header.sample_rate = config.sample_rate;
-    _default_header.byte_rate = (config.sample_rate * BITS_PER_SAMPLE) / 8;
+    return 0;
+}
+
 
-    // Write header
-    size_t size_written = fwrite(&_default_header, 1u, sizeof(_default_header), fp);
-    if (sizeof(_default_header) != size_written)
+/**
+ * @see ptttl_to_wav.h
+ */
+int ptttl_to_wav_sink(ptttl_parser_t *parser, ptttl_output_sink_t *sink,
+                      ptttl_to_wav_config_t *config)
+{
+    return ptttl_to_wav_range_sink(parser, sink, config, 0u, UINT64_MAX);
+}
+
+
+/**
+ * @see ptttl_to_wav.h
+ */
+int ptttl_to_wav_stream(ptttl_parser_t *parser, FILE *wav_stream)
+{
+    if (NULL == parser)
     {
-        ERROR(parser, "Failed to write to WAV file");
-        fclose(fp);
         return -1;
     }
 
+    ptttl_output_sink_t sink;
+    if (0 != ptttl_output_sink_init_stdio(&sink, wav_stream))
+    {
+        ERROR(parser, "NULL pointer passed to function");
+        return -1;
+    }
+
+    ptttl_to_wav_config_t config = PTTTL_TO_WAV_CONFIG_DEFAULT;
+    return ptttl_to_wav_sink(parser, &sink, &config);
+}
+
+
+/**
+ * @see ptttl_to_wav.h
+ */
+int ptttl_to_wav(ptttl_parser_t *parser, const char *wav_filename)
+{
+    if (NULL == parser)
+    {
+        return -1;
+    }
+
+    if (NULL == wav_filename)
+    {
+        ERROR(parser, "NULL pointer passed to function");
+        return -1;
+    }
+
+    FILE *fp = fopen(wav_filename, "wb");
+    if (NULL == fp)
+    {
+        ERROR(parser, "Unable to open WAV file for writing");
+        return -1;
+    }
+
+    int ret = ptttl_to_wav_stream(parser, fp);
+
     fclose(fp);
 
-    return 0;
+    return ret;
 }
@@ -3,9 +3,9 @@
  * Converts the output of ptttl_parse() into a WAV file.
  * No dynamic memory allocation, and no loading the entire WAV file in memory.
  *
- * Requires ptttl_parser.c and ptttl_sample_generator.c
+ * Requires ptttl_parser.c, ptttl_sample_generator.c and ptttl_output_sink.c
  *
- * Requires stdint.h, and fopen/fseek/fwrite from stdio.h
+ * Requires stdint.h, and fopen/fwrite from stdio.h
  *
  * See https://github.com/eriknyquist/ptttl for more details about PTTTL.
  *
@@ -16,7 +16,10 @@
 #define PTTTL_TO_WAV_H
 
 
+#include <stdio.h>
 #include "ptttl_parser.h"
+#include "ptttl_sample_generator.h"
+#include "ptttl_output_sink.h"
 
 
 #ifdef __cplusplus
@@ -24,6 +27,84 @@
 #endif
 
 
+/**
+ * Number of samples generated and written at a time, when no sample buffer is
+ * provided in ptttl_to_wav_config_t. The default buffer is allocated on the stack.
+ */
+#ifndef PTTTL_TO_WAV_DEFAULT_CHUNK_SAMPLES
+#define PTTTL_TO_WAV_DEFAULT_CHUNK_SAMPLES (1024u)
+#endif // PTTTL_TO_WAV_DEFAULT_CHUNK_SAMPLES
+
+/**
+ * Size in bytes of each IMA ADPCM block, per channel, when IMA ADPCM encoding is used.
+ * Must be a multiple of 4, and at least 8. One block is buffered on the stack while it
+ * is being encoded. Larger blocks have slightly less overhead (4 bytes per channel per
+ * block), but smaller blocks recover faster from prediction errors.
+ */
+#ifndef PTTTL_TO_WAV_ADPCM_BLOCK_SIZE
+#define PTTTL_TO_WAV_ADPCM_BLOCK_SIZE (512u)
+#endif // PTTTL_TO_WAV_ADPCM_BLOCK_SIZE
+
+
+/**
+ * ptttl_to_wav_config_t object initialization with sane defaults
+ */
+#define PTTTL_TO_WAV_CONFIG_DEFAULT {.generator_config=PTTTL_SAMPLE_GENERATOR_CONFIG_DEFAULT, \
+                                     .sample_buf=NULL, .sample_buf_len=0u,                  \
+                                     .encoding=PTTTL_WAV_ENCODING_PCM, .headerless=0u}
+
+/**
+ * ptttl_to_wav_config_t object initialization for telephony: 8kHz G.711 mu-law, as
+ * expected by most IVR and SIP platforms. Use PTTTL_WAV_ENCODING_ALAW instead for
+ * A-law (e.g. for European networks).
+ */
+#define PTTTL_TO_WAV_CONFIG_TELEPHONY {.generator_config=PTTTL_SAMPLE_GENERATOR_CONFIG_TELEPHONY, \
+                                       .sample_buf=NULL, .sample_buf_len=0u,                    \
+                                       .encoding=PTTTL_WAV_ENCODING_MULAW, .headerless=0u}
+
+
+/**
+ * Enumerates all supported encodings for the sample data in a .wav file
+ */
+typedef enum
+{
+    PTTTL_WAV_ENCODING_PCM = 0,   ///< Uncompressed samples, in the generator's sample format (default)
+    PTTTL_WAV_ENCODING_IMA_ADPCM, ///< 4-bit IMA ADPCM (WAVE_FORMAT_DVI_ADPCM), requires signed 16-bit samples
+    PTTTL_WAV_ENCODING_MULAW,     ///< 8-bit G.711 mu-law, requires signed 16-bit samples
+    PTTTL_WAV_ENCODING_ALAW,      ///< 8-bit G.711 A-law, requires signed 16-bit samples
+    PTTTL_WAV_ENCODING_COUNT
+} ptttl_wav_encoding_e;
+
+
+/**
+ * Holds configurable parameters for WAV file generation
+ */
+typedef struct
+{
+    ptttl_sample_generator_config_t generator_config; ///< Sample generator configuration
+
+    /**
+     * Optional buffer to generate samples into before writing them to the output sink.
+     * The buffer size determines how many samples are passed to the sink in each write.
+     * Samples are stored in the sample format selected in generator_config, so the
+     * buffer must be suitably aligned for that format.
+     * If NULL, a stack buffer of #PTTTL_TO_WAV_DEFAULT_CHUNK_SAMPLES samples is used
+     * (shared between all output channels).
+     */
+    void *sample_buf;
+
+    uint32_t sample_buf_len;  ///< Size of sample_buf, in sample frames (one sample per output channel). Ignored if sample_buf is NULL.
+    ptttl_wav_encoding_e encoding; ///< Encoding of sample data in the .wav file
+
+    /**
+     * If 1, only the encoded sample data is written, with no .wav header (e.g. a raw
+     * G.711 stream for a telephony platform). The sample rate, channel count and
+     * encoding must then be known to the reader by other means.
+     */
+    uint8_t headerless;
+} ptttl_to_wav_config_t;
+
+
 /**
  * Return error info after ptttl_to_wav has returned -1
  *
@@ -32,6 +113,81 @@
  */
 ptttl_parser_error_t ptttl_to_wav_error(void);
 
+/**
+ * Generate samples for some parsed PTTTL data and write them to an output sink in .wav
+ * format. The total length is found up front (with #ptttl_compute_total_samples, unless
+ * the generator configuration has a timeline or seek index that already holds it), so
+ * the output is written strictly sequentially, and the sink does not need to support
+ * seeking. No dynamic memory allocation.
+ *
+ * Signed 16-bit, signed 24-bit and unsigned 8-bit samples are written as integer PCM,
+ * and 32-bit float samples are written as IEEE float (format tag 3). Signed 8-bit
+ * samples cannot be represented in a .wav file, and are rejected. Multiple output
+ * channels (see 'output_channels' in ptttl_sample_generator_config_t) are written as
+ * interleaved frames, with a matching channel count in the .wav header.
+ *
+ * If IMA ADPCM encoding is selected, samples are encoded one block at a time as they
+ * are generated, for roughly 4x smaller output than 16-bit PCM. The last block is
+ * padded with silence; the real length is stored in the 'fact' chunk.
+ *
+ * If G.711 mu-law or A-law encoding is selected, samples are encoded by table lookup
+ * into 8-bit samples, in place in the sample buffer. Use #PTTTL_TO_WAV_CONFIG_TELEPHONY
+ * to render natively at 8kHz for telephony, with no resampling required.
+ *
+ * @param parser         Pointer to initialized parser object
+ * @param sink           Pointer to output sink to write .wav data to
+ * @param config         Pointer to WAV generation configuration data
+ *
+ * @return 0 if successful, -1 if an error occurred. Call #ptttl_to_wav_error for
+ *         an error description if -1 is returned.
+ */
+int ptttl_to_wav_sink(ptttl_parser_t *parser, ptttl_output_sink_t *sink,
+                      ptttl_to_wav_config_t *config);
+
+/**
+ * Generate samples for a window of some parsed PTTTL data, e.g. for a preview, and write
+ * them to an output sink as a complete .wav file holding only that window. Works like
+ * #ptttl_to_wav_sink, except that notes before the window are skipped by their durations
+ * only, with no synthesis (see #ptttl_sample_generator_seek), and synthesis stops at the
+ * end of the window, so synthesis costs time in proportion to the length of the window
+ * rather than the length of the song.
+ *
+ * The .wav header needs the length of the song, which is taken from the timeline or seek
+ * index in the generator configuration, if there is one (see #ptttl_timeline_compile and
+ * #ptttl_seek_index_init); otherwise it is calculated with a pass over the whole song. A
+ * seek index also means that only the block playing at the start of the window is parsed
+ * when skipping to it, so rendering several windows of the same song with one seek index
+ * avoids parsing the whole song for each of them.
+ *
+ * @param parser         Pointer to initialized parser object
+ * @param sink           Pointer to output sink to write .wav data to
+ * @param config         Pointer to WAV generation configuration data
+ * @param start_sample   Index of the first sample frame to write
+ * @param end_sample     Index of the sample frame after the last one to write. If this is
+ *                       past the end of the song, the window ends at the end of the song.
+ *
+ * @return 0 if successful, -1 if an error occurred. Call #ptttl_to_wav_error for
+ *         an error description if -1 is returned.
+ */
+int ptttl_to_wav_range_sink(ptttl_parser_t *parser, ptttl_output_sink_t *sink,
+                            ptttl_to_wav_config_t *config, uint64_t start_sample,
+                            uint64_t end_sample);
+
+/**
+ * Generate samples for some parsed PTTTL data and write them directly to an open stream
+ * in .wav format. The total length is calculated up front with #ptttl_compute_total_samples,
+ * so the stream is written strictly sequentially (no seeking), and can be a pipe, socket
+ * or stdout. No dynamic memory allocation. Does not require holding the entire .wav file
+ * in memory at once.
+ *
+ * @param parser         Pointer to initialized parser object
+ * @param wav_stream     Stream to write .wav data to. Must be opened for writing in binary mode.
+ *
+ * @return 0 if successful, -1 if an error occurred. Call #ptttl_to_wav_error for
+ *         an error description if -1 is returned.
+ */
+int ptttl_to_wav_stream(ptttl_parser_t *parser, FILE *wav_stream);
+
 /**
  * Generate samples for some parsed PTTTL data and write them directly to a .wav file.
  * No dynamic memory allocation. Does not require holding the entire .wav file in memory